@@ -18,7 +18,9 @@
 
 #include "driver/tool.h"
 #include "driver/cl_options.h"
+#include "driver/cppserver.h"
 #include "gen/irstate.h"
+#include "gen/timetrace.h"
 
 #include "clang/AST/DeclTemplate.h"
 #include "clang/Basic/SourceLocation.h"
@@ -476,6 +478,8 @@ const clang::Decl *getDecl(Dsymbol *s)
     RETRIEVE(EnumDeclaration, ED)
     RETRIEVE(CtorDeclaration, CCD)
     RETRIEVE(DtorDeclaration, CDD)
+    RETRIEVE(NewDeclaration, FD)
+    RETRIEVE(DeleteDeclaration, FD)
     RETRIEVE(FuncDeclaration, FD)
     RETRIEVE(VarDeclaration, VD)
 
@@ -586,6 +590,65 @@ void InstantiationChecker::FunctionDefinitionInstantiated(const clang::FunctionD
 
 /***********************/
 
+void LayerRecorder::setListener(clang::ASTDeserializationListener *L)
+{
+    Listener = L;
+    for (auto& E: Recorded)
+        E(Listener);
+    Recorded.clear();
+}
+
+void LayerRecorder::forward(Event E)
+{
+    if (Listener)
+        E(Listener);
+    else
+        Recorded.push_back(std::move(E));
+}
+
+void LayerRecorder::ReaderInitialized(clang::ASTReader *Reader)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->ReaderInitialized(Reader); });
+}
+
+void LayerRecorder::IdentifierRead(clang::serialization::IdentID ID, clang::IdentifierInfo *II)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->IdentifierRead(ID, II); });
+}
+
+void LayerRecorder::MacroRead(clang::serialization::MacroID ID, clang::MacroInfo *MI)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->MacroRead(ID, MI); });
+}
+
+void LayerRecorder::TypeRead(clang::serialization::TypeIdx Idx, clang::QualType T)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->TypeRead(Idx, T); });
+}
+
+void LayerRecorder::DeclRead(clang::serialization::DeclID ID, const clang::Decl *D)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->DeclRead(ID, D); });
+}
+
+void LayerRecorder::SelectorRead(clang::serialization::SelectorID ID, clang::Selector Sel)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->SelectorRead(ID, Sel); });
+}
+
+void LayerRecorder::MacroDefinitionRead(clang::serialization::PreprocessedEntityID ID,
+                                        clang::MacroDefinitionRecord *MD)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->MacroDefinitionRead(ID, MD); });
+}
+
+void LayerRecorder::ModuleRead(clang::serialization::SubmoduleID ID, clang::Module *Mod)
+{
+    forward([=] (clang::ASTDeserializationListener *L) { L->ModuleRead(ID, Mod); });
+}
+
+/***********************/
+
 DiagMuter::DiagMuter()
 {
     calypso.pch.DiagClient->muted = true;
@@ -600,34 +663,86 @@ DiagMuter::~DiagMuter()
 
 #define MAX_FILENAME_SIZE 4096
 
-void PCH::init()
+static void readCacheList(const std::string& filename, Strings& lines)
 {
-    clang::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts(new clang::DiagnosticOptions);
-    clang::IntrusiveRefCntPtr<clang::DiagnosticIDs> DiagID(new clang::DiagnosticIDs);
-    DiagClient = new DiagnosticPrinter(llvm::errs(), &*DiagOpts);
-    DiagClient->muted = !opts::cppVerboseDiags;
-    Diags = new clang::DiagnosticsEngine(DiagID,
-                                         &*DiagOpts, DiagClient);
-
-    auto headerList = calypso.getCacheFilename();
-
-    auto fheaderList = fopen(headerList.c_str(), "r"); // ordered list of headers
-        // currently cached as one big PCH (neither modules nor chained PCH can be
-        // used without modifying Clang).
-    if (!fheaderList)
+    auto flist = fopen(filename.c_str(), "r");
+    if (!flist)
         return;
 
     char linebuf[MAX_FILENAME_SIZE];
-    while (fgets(linebuf, MAX_FILENAME_SIZE, fheaderList) != NULL)
+    while (fgets(linebuf, MAX_FILENAME_SIZE, flist) != NULL)
     {
         linebuf[strcspn(linebuf, "\n")] = '\0';
         if (linebuf[0] == '\0')
             continue;
 
-        headers.push(strdup(linebuf));
+        lines.push(strdup(linebuf));
+    }
+
+    fclose(flist);
+}
+
+// Each line of the layer list is a layer followed by a tab and the layer it is chained to, or nothing
+// if it was chained to the PCH itself. Compilations running concurrently may chain layers to the same
+// parent, only the last one listed and its ancestors can be loaded together. The others are superseded,
+// and the ones listed before the first layer of the loaded chain are deleted once a new layer is saved.
+void PCH::readLayerList()
+{
+    Strings entries;
+    readCacheList(calypso.getCacheFilename(".h.pch.layers"), entries);
+
+    llvm::StringMap<std::string> parents;
+    for (unsigned i = 0; i < entries.dim; ++i)
+    {
+        auto entry = llvm::StringRef(entries[i]).split('\t');
+        parents[entry.first] = entry.second;
+    }
+
+    llvm::StringSet<> chain;
+    std::vector<std::string> chainReversed;
+    if (!entries.empty())
+    {
+        std::string layer = llvm::StringRef(entries[entries.dim - 1]).split('\t').first;
+        while (!layer.empty() && parents.count(layer) && chain.insert(layer).second)
+        {
+            chainReversed.push_back(layer);
+            layer = parents[layer];
+        }
+    }
+
+    for (auto I = chainReversed.rbegin(), E = chainReversed.rend(); I != E; ++I)
+        layers.push(strdup(I->c_str()));
+
+    bool beforeChain = true;
+    for (unsigned i = 0; i < entries.dim; ++i)
+    {
+        auto layer = llvm::StringRef(entries[i]).split('\t').first;
+        if (chain.count(layer))
+        {
+            beforeChain = false;
+            continue;
+        }
+
+        supersededLayers.push(strdup(layer.str().c_str()));
+        if (beforeChain)
+            staleLayers.push(supersededLayers[supersededLayers.dim - 1]);
     }
+}
+
+void PCH::init()
+{
+    clang::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts(new clang::DiagnosticOptions);
+    clang::IntrusiveRefCntPtr<clang::DiagnosticIDs> DiagID(new clang::DiagnosticIDs);
+    DiagClient = new DiagnosticPrinter(llvm::errs(), &*DiagOpts);
+    DiagClient->muted = !opts::cppVerboseDiags;
+    Diags = new clang::DiagnosticsEngine(DiagID,
+                                         &*DiagOpts, DiagClient);
 
-    fclose(fheaderList);
+    readCacheList(calypso.getCacheFilename(), headers); // ordered list of headers
+        // cached as one big PCH, or with -cpp-modules as one PCH for the non-modular headers
+        // plus one module file per Clang module (chained PCH cannot be used without modifying Clang).
+    readCacheList(calypso.getCacheFilename(".modulemaps"), moduleMaps);
+    readLayerList();
 }
 
 void PCH::add(const char* header, ::Module *from)
@@ -660,6 +775,32 @@ void PCH::add(const char* header, ::Module *from)
     needHeadersReload = true;
 }
 
+bool PCH::addModuleMap(const char* path)
+{
+    for (unsigned i = 0; i < moduleMaps.dim; i++)
+        if (strcmp(path, moduleMaps[i]) == 0)
+            return false;
+
+    moduleMaps.push(strdup(path));
+    return true;
+}
+
+void PCH::saveModuleMapList()
+{
+    auto moduleMapList = calypso.getCacheFilename(".modulemaps");
+    auto fmodulemaplist = fopen(moduleMapList.c_str(), "w");
+    if (fmodulemaplist == NULL)
+    {
+        ::error(Loc(), "C/C++ module map list cache file couldn't be opened/created");
+        fatal();
+    }
+
+    for (unsigned i = 0; i < moduleMaps.dim; ++i)
+        fprintf(fmodulemaplist, "%s\n", moduleMaps[i]);
+
+    fclose(fmodulemaplist);
+}
+
 void PCH::loadFromHeaders(clang::driver::Compilation* C)
 {
     // We use a trick from clang-interpreter to extract -cc1 flags from "puny human" flags
@@ -675,6 +816,9 @@ void PCH::loadFromHeaders(clang::driver::Compilation* C)
     clang::CompilerInvocation CI;
     clang::CompilerInvocation::CreateFromArgs(CI, CCArgs.begin(), CCArgs.end(), *Diags);
 
+    LayerConsumer.reset(); // the whole AST gets saved into a new PCH
+    Recorder = nullptr;
+
     // Parse the headers
     DiagClient->muted = false;
 
@@ -684,6 +828,7 @@ void PCH::loadFromHeaders(clang::driver::Compilation* C)
 
     PCHContainerOps.reset(new clang::PCHContainerOperations);
 
+    clearASTCaches();
     AST = ASTUnit::LoadFromCompilerInvocation(&CI, PCHContainerOps, Diags, Files, false, false, false,
                                               clang::TU_Complete, false, false, false,
                                               new InstantiationChecker).release();
@@ -714,18 +859,23 @@ void PCH::loadFromHeaders(clang::driver::Compilation* C)
 
     fclose(fheaderlist);
 
+    /* The layers were chained to the previous PCH */
+
+    removeLayers();
+
     /* Mark every C++ module object file dirty */
 
     auto genListFilename = calypso.getCacheFilename(".gen");
     llvm::sys::fs::remove(genListFilename, true);
 }
 
-// WORKAROUND Temporary visitor to deserialize the entire ASTContext
-class ASTDummyVisitor : public clang::RecursiveASTVisitor<ASTDummyVisitor>
+// The caches keyed by the declarations of the previous AST would otherwise return dangling pointers,
+// or get false hits from new declarations allocated at the same addresses.
+void PCH::clearASTCaches()
 {
-public:
-    bool shouldVisitTemplateInstantiations() const { return true; }
-};
+    clearInstCache();
+    clearLoadedFields();
+}
 
 void PCH::loadFromPCH(clang::driver::Compilation* C)
 {
@@ -737,10 +887,17 @@ void PCH::loadFromPCH(clang::driver::Compilation* C)
     PCHContainerOps.reset(new clang::PCHContainerOperations);
     auto *Reader = PCHContainerOps->getReaderOrNull("raw");
 
-    AST = ASTUnit::LoadFromASTFile(pchFilename, *Reader,
+    // Loading the last layer also loads the PCH and the layers below it
+    std::string topFilename = layers.empty() ? pchFilename : layers[layers.dim - 1];
+
+    // The consumer is the reader's deserialization listener from the start, so that the writer of
+    // the next layer learns about everything read from the PCH and its layers.
+    Recorder = new LayerRecorder;
+    clearASTCaches();
+    AST = ASTUnit::LoadFromASTFile(topFilename, *Reader,
                             Diags, FileSystemOpts, false, false, llvm::None, false,
                             /* AllowPCHWithCompilerErrors = */ true, false,
-                            new InstantiationChecker, &ReadResult).release();
+                            Recorder, &ReadResult).release();
 
     DiagClient->muted = !opts::cppVerboseDiags;
 
@@ -754,6 +911,7 @@ void PCH::loadFromPCH(clang::driver::Compilation* C)
         case clang::ASTReader::VersionMismatch:
         case clang::ASTReader::ConfigurationMismatch:
             delete AST;
+            Recorder = nullptr;
             Diags->Reset();
 
             // Headers or flags may have changed since the PCH was generated, fall back to headers.
@@ -768,10 +926,18 @@ void PCH::loadFromPCH(clang::driver::Compilation* C)
     if (!AST)
         fatal();
 
-    // WORKAROUND for https://llvm.org/bugs/show_bug.cgi?id=24420
-    // « RecordDecl::LoadFieldsFromExternalStorage() expels existing decls from the DeclContext linked list »
-    // This only concerns serialized declarations, new records aren't affected by this issue
-    ASTDummyVisitor().TraverseDecl(AST->getASTContext().getTranslationUnitDecl());
+    if (global.params.verbose)
+    {
+        for (unsigned i = 0; i < layers.dim; ++i)
+            fprintf(global.stdmsg, "pchlayer  %s\n", layers[i]);
+        for (unsigned i = 0; i < supersededLayers.dim; ++i)
+            fprintf(global.stdmsg, "pchlayer  %s (superseded, its instantiations are redone)\n", supersededLayers[i]);
+    }
+
+    beginLayer();
+
+    // NOTE: declarations are deserialized lazily, the fields of the records mapped by Calypso are
+    // force-loaded by forceLoadFields() to work around https://llvm.org/bugs/show_bug.cgi?id=24420
 }
 
 void PCH::update()
@@ -782,6 +948,11 @@ void PCH::update()
     if (!needHeadersReload && AST)
         return;
 
+    TimeTraceScope timeScope("C++ headers");
+
+    if (needHeadersReload && AST && preloaded)
+        restartCompilationWithoutServer(); // new headers in a process forked by the compile server
+
     // FIXME
     assert(!(needHeadersReload && AST) && "Need AST merging FIXME");
 
@@ -806,6 +977,9 @@ void PCH::update()
     pchFilename = AddSuffixThenCheck(".h.pch");
 //     pchFilenameNew = AddSuffixThenCheck(".new.pch", false);
 
+    if (layers.dim + supersededLayers.dim >= maxLayers)
+        needHeadersReload = true; // merge the layers back into one PCH
+
     if (needHeadersReload)
     {
         // Re-emit the source file with #include directives
@@ -841,6 +1015,23 @@ void PCH::update()
     Argv.push_back("clang");
     for (auto& cppArg: opts::cppArgs)
         Argv.push_back(cppArg.c_str());
+
+    // Let Clang build every module described by the known module maps into its own module file, under a cache path
+    // shared by all the D targets using this cache directory. Clang rebuilds them only when their headers change,
+    // holds a lock while building one so that concurrent compilations don't duplicate work, and the declarations
+    // they contain are only deserialized once looked up.
+    std::vector<std::string> ModuleArgs;
+    if (opts::cppModules)
+    {
+        ModuleArgs.push_back("-fmodules-cache-path=" + calypso.getCacheFilename("_modules"));
+        for (unsigned i = 0; i < moduleMaps.dim; ++i)
+            ModuleArgs.push_back(std::string("-fmodule-map-file=") + moduleMaps[i]);
+
+        Argv.push_back("-fmodules");
+        for (auto& ModuleArg: ModuleArgs)
+            Argv.push_back(ModuleArg.c_str());
+    }
+
     Argv.push_back("-c");
     Argv.push_back("-x");
     Argv.push_back("c++-header");
@@ -871,6 +1062,7 @@ void PCH::update()
     MMap = new ModuleMap(AST->getSourceManager(), *Diags,
                             PP.getLangOpts(), &PP.getTargetInfo(), PP.getHeaderSearchInfo());
 
+    bool newModuleMaps = false;
     llvm::DenseSet<const clang::DirectoryEntry*> CheckedDirs;
     auto lookForModuleMap = [&] (const clang::SrcMgr::SLocEntry& SLoc) {
         if (SLoc.isExpansion())
@@ -905,6 +1097,9 @@ void PCH::update()
                                     MMapFile->getDir(), MMapFile->getName());
                     fatal();
                 }
+
+                if (addModuleMap(path.c_str()))
+                    newModuleMaps = true;
             }
         }
     };
@@ -928,6 +1123,23 @@ void PCH::update()
         return update();
     }
 
+    if (newModuleMaps)
+    {
+        saveModuleMapList();
+
+        // Module maps are only discovered after a first parse, reparse so that the new modules get built
+        // into their own module files instead of ending up in the PCH.
+        if (opts::cppModules)
+        {
+            delete AST;
+            delete MMap;
+            AST = nullptr;
+
+            needHeadersReload = true;
+            return update();
+        }
+    }
+
     // Build the builtin type map
     calypso.builtinTypes.build(AST->getASTContext());
 
@@ -1004,7 +1216,14 @@ void PCH::save()
     if (!needSaving)
         return;
 
-    if (AST->getASTContext().getExternalSource() != nullptr) // FIXME: Clang makes it hard to save a new PCH when an external source like another PCH is loaded by the ASTContext
+    if (LayerConsumer)
+    {
+        saveLayer();
+        return;
+    }
+
+    if (AST->getASTContext().getExternalSource() != nullptr // FIXME: Clang makes it hard to save a new PCH when an external source like another PCH is loaded by the ASTContext
+            && !(opts::cppModules && !AST->isMainFileAST())) // module files as external source are fine though
         return;
 
     auto& PP = AST->getPreprocessor();
@@ -1034,6 +1253,96 @@ void PCH::save()
     needSaving = false;
 }
 
+void PCH::beginLayer()
+{
+    auto& PP = AST->getPreprocessor();
+    auto& Sysroot = PP.getHeaderSearchInfo().getHeaderSearchOpts().Sysroot;
+    LayerBuffer = std::make_shared<clang::PCHBuffer>();
+
+    // The writer is chained to the reader, so that it only serializes the new declarations and the updates
+    // to the deserialized ones. It must be told about every change, hence the multiplexed mutation listener.
+    auto GenPCH = new clang::PCHGenerator(PP, pchFilename,
+                                          nullptr, Sysroot, LayerBuffer,
+                                          llvm::ArrayRef<llvm::IntrusiveRefCntPtr<clang::ModuleFileExtension>>(),
+                                          true);
+
+    std::vector<std::unique_ptr<clang::ASTConsumer>> Consumers;
+    Consumers.push_back(llvm::make_unique<InstantiationChecker>());
+    Consumers.push_back(std::unique_ptr<clang::ASTConsumer>(GenPCH));
+    LayerConsumer = llvm::make_unique<clang::MultiplexConsumer>(std::move(Consumers));
+
+    // The recorder has been listening to the reader since before the PCH got loaded, now that the writer
+    // exists it receives what was read so far.
+    auto Reader = AST->getASTReader();
+    if (Reader->getDeserializationListener() != Recorder)
+    {
+        Recorder->ReaderInitialized(Reader.get());
+        Reader->setDeserializationListener(Recorder);
+    }
+    Recorder->setListener(LayerConsumer->GetASTDeserializationListener());
+
+    AST->getASTContext().setASTMutationListener(LayerConsumer->GetASTMutationListener());
+    LayerConsumer->InitializeSema(AST->getSema());
+}
+
+void PCH::saveLayer()
+{
+    using namespace llvm::sys::fs;
+
+    // Concurrent compilations may add a layer at the same time, give each its own file.
+    int FD;
+    llvm::SmallString<128> LayerFilename;
+    if (createUniqueFile(pchFilename + ".%%%%%%%%", FD, LayerFilename))
+    {
+        ::warning(Loc(), "C++ instantiations couldn't be cached, PCH layer file couldn't be created");
+        return;
+    }
+
+    auto& Context = AST->getASTContext();
+    LayerConsumer->HandleTranslationUnit(Context);
+
+    std::unique_ptr<llvm::raw_fd_ostream> OS(new llvm::raw_fd_ostream(FD, /*shouldClose=*/ true));
+    auto *Writer = PCHContainerOps->getWriterOrNull("raw");
+    auto Container = Writer->CreatePCHContainerGenerator(
+        *static_cast<clang::CompilerInstance*>(nullptr), pchHeader, LayerFilename.str(), std::move(OS), LayerBuffer);
+    Container->HandleTranslationUnit(Context);
+
+    // The layer list is only ever appended to, each layer along with its parent
+    const char *parent = layers.empty() ? "" : layers[layers.dim - 1];
+    auto layerList = calypso.getCacheFilename(".h.pch.layers");
+    auto flayerlist = fopen(layerList.c_str(), "a");
+    if (flayerlist == NULL)
+    {
+        ::error(Loc(), "C/C++ PCH layer list cache file couldn't be opened/created");
+        fatal();
+    }
+    fprintf(flayerlist, "%s\t%s\n", LayerFilename.c_str(), parent);
+    fclose(flayerlist);
+
+    layers.push(strdup(LayerFilename.c_str()));
+    needSaving = false;
+
+    // The compilations which could still be using the stale layers started before the loaded chain did.
+    // Their entries stay in the list until the next reparse, so that they keep counting toward maxLayers.
+    for (unsigned i = 0; i < staleLayers.dim; ++i)
+        llvm::sys::fs::remove(staleLayers[i], true);
+    staleLayers.setDim(0);
+}
+
+void PCH::removeLayers()
+{
+    for (unsigned i = 0; i < layers.dim; ++i)
+        llvm::sys::fs::remove(layers[i], true);
+    layers.setDim(0);
+
+    for (unsigned i = 0; i < supersededLayers.dim; ++i)
+        llvm::sys::fs::remove(supersededLayers[i], true);
+    supersededLayers.setDim(0);
+    staleLayers.setDim(0);
+
+    llvm::sys::fs::remove(calypso.getCacheFilename(".h.pch.layers"), true);
+}
+
 void LangPlugin::GenModSet::parse()
 {
     if (parsed)
@@ -1241,6 +1550,24 @@ clang::SourceManager& LangPlugin::getSourceManager()
     return getASTUnit()->getSourceManager();
 }
 
+LangPlugin::ClangMemoryUsage LangPlugin::getClangMemoryUsage()
+{
+    ClangMemoryUsage usage;
+    if (!getASTUnit())
+        return usage;
+
+    auto& Context = getASTContext();
+    usage.ast = Context.getASTAllocatedMemory();
+    usage.sideTables = Context.getSideTableAllocatedMemory();
+
+    auto& SrcMgr = getSourceManager();
+    usage.sourceManager = SrcMgr.getContentCacheSize() + SrcMgr.getDataStructureSizes() +
+        SrcMgr.getMemoryBufferSizes().malloc_bytes;
+
+    usage.preprocessor = getPreprocessor().getTotalMemory();
+    return usage;
+}
+
 std::string LangPlugin::getCacheFilename(const char *suffix)
 {
     using namespace llvm::sys::path;
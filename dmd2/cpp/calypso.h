@@ -11,12 +11,17 @@
 #include "../import.h"
 #include "../gen/cgforeign.h"
 
+#include <functional>
+#include <map>
 #include <memory>
+#include <vector>
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/IR/DataLayout.h"
 #include "clang/AST/ASTMutationListener.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Sema/DeclSpec.h"
+#include "clang/Serialization/ASTDeserializationListener.h"
 #include "clang/CodeGen/ModuleBuilder.h"
 #include "clang/lib/CodeGen/CodeGenModule.h"
 
@@ -33,6 +38,7 @@ class ASTUnit;
 class MacroInfo;
 class ModuleMap;
 class PCHContainerOperations;
+struct PCHBuffer;
 namespace driver { class Compilation; }
 }
 
@@ -87,6 +93,33 @@ public:
     void FunctionDefinitionInstantiated(const clang::FunctionDecl *D) override;
 };
 
+// Consumer of a PCH loaded from the cache. The chained writer of the next layer must be told about everything
+// the reader deserializes, starting with the load itself, but it needs the preprocessor which only exists once
+// the AST is loaded. So the deserialization events are recorded until the writer is ready, then replayed.
+class LayerRecorder : public InstantiationChecker, public clang::ASTDeserializationListener
+{
+public:
+    clang::ASTDeserializationListener *GetASTDeserializationListener() override { return this; }
+    void setListener(clang::ASTDeserializationListener *L); // replays the recorded events to L, then forwards them
+
+    void ReaderInitialized(clang::ASTReader *Reader) override;
+    void IdentifierRead(clang::serialization::IdentID ID, clang::IdentifierInfo *II) override;
+    void MacroRead(clang::serialization::MacroID ID, clang::MacroInfo *MI) override;
+    void TypeRead(clang::serialization::TypeIdx Idx, clang::QualType T) override;
+    void DeclRead(clang::serialization::DeclID ID, const clang::Decl *D) override;
+    void SelectorRead(clang::serialization::SelectorID ID, clang::Selector Sel) override;
+    void MacroDefinitionRead(clang::serialization::PreprocessedEntityID ID,
+                             clang::MacroDefinitionRecord *MD) override;
+    void ModuleRead(clang::serialization::SubmoduleID ID, clang::Module *Mod) override;
+
+private:
+    typedef std::function<void(clang::ASTDeserializationListener *)> Event;
+    clang::ASTDeserializationListener *Listener = nullptr;
+    std::vector<Event> Recorded;
+
+    void forward(Event E);
+};
+
 class DiagMuter
 {
 public:
@@ -101,6 +134,7 @@ public:
             // the array is initialized at the first Modmap::semantic and kept in sync with a cache file named 'calypso_cache.list'
             // TODO: it's currently pretty basic and dumb and doesn't check whether the same header might be named differently or is already included by another
     bool needHeadersReload = false;
+    bool preloaded = false; // loaded by the compile server before forking the process, see driver/cppserver.h
     ASTUnit *AST = nullptr;
     clang::MangleContext *MangleCtx = nullptr;
 
@@ -109,6 +143,8 @@ public:
     std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps;
     
     ModuleMap *MMap = nullptr;
+    Strings moduleMaps; // .modulemap_d files found next to the headers, kept in sync with 'calypso_cache.modulemaps'
+            // with -cpp-modules each module they describe is built into its own module file by Clang, and the PCH only contains the non-modular headers
 
     void init(); // load the list of headers already cached in the PCH
     void add(const char* header, ::Module *from);
@@ -116,17 +152,35 @@ public:
     void update(); // re-emit the PCH if needed, and update the cached list
 
     bool needSaving = false;
-    void save();
+    void save(); // called once at the end of the compilation
 
     std::string pchHeader;
     std::string pchFilename;
 //     std::string pchFilenameNew; // the PCH may be updated by Calypso, but into a different file since the original PCH is still opened as external source for the ASTContext
 
+    Strings layers; // chained PCH files holding the instantiations made since the PCH was generated, listed in 'calypso_cache.h.pch.layers' along with the layer each one is chained to
+            // each one only contains what was added on top of its parent, the last one listed is loaded along with the PCH and its ancestors
+    Strings supersededLayers; // layers chained to the same parent as a later one by concurrent compilations, which can't be loaded anymore
+    Strings staleLayers; // the superseded layers listed before the loaded chain, deleted once a new layer is saved
+    static const unsigned maxLayers = 32; // past this many listed layers, superseded ones included, the headers are reparsed into a single PCH again
+
     int cxxStdlibType;
 
 protected:
     void loadFromHeaders(clang::driver::Compilation* C);
     void loadFromPCH(clang::driver::Compilation* C);
+    void clearASTCaches();
+    bool addModuleMap(const char* path); // returns true if the module map wasn't known yet
+    void saveModuleMapList();
+
+    // Records the AST changes made on top of a loaded PCH, to be written as a new layer
+    LayerRecorder *Recorder = nullptr; // owned by the AST
+    std::unique_ptr<clang::ASTConsumer> LayerConsumer;
+    std::shared_ptr<clang::PCHBuffer> LayerBuffer;
+    void readLayerList();
+    void beginLayer();
+    void saveLayer();
+    void removeLayers();
 };
 
 class LangPlugin : public ::LangPlugin, public ::ForeignCodeGen
@@ -247,6 +301,16 @@ public:
         void add(::Module *m);
     } genModSet;
 
+    // with -cpp-partitions, each C++ template instance is owned by the partition its mangled name hashes to, so that which object
+    // defines it doesn't depend on the order the partitions are emitted in. The other partitions only declare it, and the instances
+    // they reference that their owner doesn't are emitted into the last partition.
+    int partition = -1; // of the object being emitted, -1 outside of the partitions
+    unsigned numPartitions = 0;
+    llvm::StringSet<> definedInstances; // by their owner
+    std::map<std::string, const clang::FunctionDecl*> foreignInstances; // referenced by a partition not owning them, sorted by name
+    std::vector<std::string> ownedInstances; // emitted into the current object, they must be kept even if unreferenced
+    void emitForeignInstances();
+
     // settings
     const char *cachePrefix = "calypso_cache"; // prefix of cached files (list of headers, PCH)
 
@@ -264,6 +328,16 @@ public:
     clang::Preprocessor &getPreprocessor();
     clang::SourceManager &getSourceManager();
 
+    // Bytes allocated by Clang, for -memory-report
+    struct ClangMemoryUsage
+    {
+        size_t ast = 0;             // AST nodes, including those created by Sema
+        size_t sideTables = 0;      // ASTContext tables besides the nodes
+        size_t sourceManager = 0;
+        size_t preprocessor = 0;
+    };
+    ClangMemoryUsage getClangMemoryUsage();
+
     std::string getCacheFilename(const char *suffix = nullptr);
 
     // FIXME quick&dirty traits addition
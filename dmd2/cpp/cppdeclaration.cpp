@@ -106,6 +106,49 @@ DtorDeclaration::DtorDeclaration(const DtorDeclaration& o)
 {
 }
 
+NewDeclaration::NewDeclaration(Loc loc, StorageClass storage_class,
+                               Type* type, const clang::FunctionDecl* FD)
+    : ::NewDeclaration(loc, loc, storage_class,
+                       static_cast<TypeFunction*>(type)->parameters,
+                       static_cast<TypeFunction*>(type)->varargs)
+{
+    this->type = type;
+    this->FD = FD;
+}
+
+NewDeclaration::NewDeclaration(const NewDeclaration& o)
+    : NewDeclaration(o.loc, o.storage_class,
+                     o.type->syntaxCopy(), o.FD)
+{
+}
+
+Dsymbol *NewDeclaration::syntaxCopy(Dsymbol *s)
+{
+    assert(!s); // ::NewDeclaration::syntaxCopy doesn't accept a destination either
+    return ::FuncDeclaration::syntaxCopy(new cpp::NewDeclaration(*this));
+}
+
+DeleteDeclaration::DeleteDeclaration(Loc loc, StorageClass storage_class,
+                                     Type* type, const clang::FunctionDecl* FD)
+    : ::DeleteDeclaration(loc, loc, storage_class,
+                          static_cast<TypeFunction*>(type)->parameters)
+{
+    this->type = type;
+    this->FD = FD;
+}
+
+DeleteDeclaration::DeleteDeclaration(const DeleteDeclaration& o)
+    : DeleteDeclaration(o.loc, o.storage_class,
+                        o.type->syntaxCopy(), o.FD)
+{
+}
+
+Dsymbol *DeleteDeclaration::syntaxCopy(Dsymbol *s)
+{
+    assert(!s);
+    return ::FuncDeclaration::syntaxCopy(new cpp::DeleteDeclaration(*this));
+}
+
 EnumDeclaration::EnumDeclaration(Loc loc, Identifier* id, Type* memtype,
                                  const clang::EnumDecl* ED)
     : ::EnumDeclaration(loc, id, memtype)
@@ -214,6 +257,18 @@ void DtorDeclaration::semantic(Scope *sc)
     const_cast<clang::CXXDestructorDecl*>(CDD)->dsym = this;
 }
 
+void NewDeclaration::semantic(Scope *sc)
+{
+    ::NewDeclaration::semantic(sc);
+    const_cast<clang::FunctionDecl*>(FD)->dsym = this;
+}
+
+void DeleteDeclaration::semantic(Scope *sc)
+{
+    ::DeleteDeclaration::semantic(sc);
+    const_cast<clang::FunctionDecl*>(FD)->dsym = this;
+}
+
 TypeMapper DeclReferencer::mapper(nullptr, true);
 ExprMapper DeclReferencer::expmap(mapper);
 
@@ -244,6 +299,9 @@ bool DeclReferencer::Reference(const clang::NamedDecl *D)
         if (FD->getBuiltinID() ||
                 (FD->isOverloadedOperator() && FD->isImplicit()))
             return true;
+        if (isa<clang::CXXMethodDecl>(FD) && (FD->getOverloadedOperator() == clang::OO_New ||
+                    FD->getOverloadedOperator() == clang::OO_Delete))
+            return true; // class allocators and deallocators are semantic'd along with their record
         if (FD->isExternC())
             return true; // FIXME: Clang 3.6 doesn't always map decls to the right source file,
                 // so the path generated by typeQualifiedFor although correct will result in a failed lookup.
@@ -488,6 +546,16 @@ void DtorDeclaration::semantic3(Scope *sc)
     cpp::FuncDeclaration::semantic3reference(this, sc);
 }
 
+void NewDeclaration::semantic3(Scope *sc)
+{
+    cpp::FuncDeclaration::semantic3reference(this, sc);
+}
+
+void DeleteDeclaration::semantic3(Scope *sc)
+{
+    cpp::FuncDeclaration::semantic3reference(this, sc);
+}
+
 const clang::FunctionDecl *getFD(::FuncDeclaration *f)
 {
     assert(isCPP(f));
@@ -496,6 +564,10 @@ const clang::FunctionDecl *getFD(::FuncDeclaration *f)
         return static_cast<CtorDeclaration*>(f)->CCD;
     else if (f->isDtorDeclaration())
         return static_cast<DtorDeclaration*>(f)->CDD;
+    else if (f->isNewDeclaration())
+        return static_cast<NewDeclaration*>(f)->FD;
+    else if (f->isDeleteDeclaration())
+        return static_cast<DeleteDeclaration*>(f)->FD;
     else
         return static_cast<FuncDeclaration*>(f)->FD;
 }
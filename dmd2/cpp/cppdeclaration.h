@@ -97,6 +97,41 @@ public:
     bool allowFinalOverride() override { return true; }
 };
 
+// Class-specific operator new, mapped to a D allocator so that new C++ records get allocated
+// the way C++ would, and placement arguments can be passed with new(args) T
+class NewDeclaration : public ::NewDeclaration
+{
+public:
+    CALYPSO_LANGPLUGIN
+
+    const clang::FunctionDecl *FD;
+
+    NewDeclaration(Loc loc, StorageClass storage_class,
+                   Type* type, const clang::FunctionDecl *FD);
+    NewDeclaration(const NewDeclaration&);
+    Dsymbol *syntaxCopy(Dsymbol *s) override;
+    void semantic(Scope *sc) override;
+    void semantic3(Scope *sc) override;
+    bool functionSemantic3() override { return true; }
+};
+
+// Class-specific operator delete, mapped to a D deallocator
+class DeleteDeclaration : public ::DeleteDeclaration
+{
+public:
+    CALYPSO_LANGPLUGIN
+
+    const clang::FunctionDecl *FD;
+
+    DeleteDeclaration(Loc loc, StorageClass storage_class,
+                      Type* type, const clang::FunctionDecl *FD);
+    DeleteDeclaration(const DeleteDeclaration&);
+    Dsymbol *syntaxCopy(Dsymbol *s) override;
+    void semantic(Scope *sc) override;
+    void semantic3(Scope *sc) override;
+    bool functionSemantic3() override { return true; }
+};
+
 class EnumDeclaration : public ::EnumDeclaration
 {
 public:
@@ -240,6 +275,8 @@ public:
 
 const clang::Decl *getCanonicalDecl(const clang::Decl *D); // the only difference with D->getCanonicalDecl() is that if the canonical decl is an out-of-ilne friend' decl and the actual decl is declared, this returns the latter instead of the former
 bool isPolymorphic(const clang::RecordDecl *D);
+void forceLoadFields(const clang::RecordDecl *D);
+void clearLoadedFields();
 
 }
 
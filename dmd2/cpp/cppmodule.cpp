@@ -13,6 +13,7 @@
 #include "statement.h"
 #include "id.h"
 #include "driver/cl_options.h"
+#include "gen/timetrace.h"
 
 #include "cpp/calypso.h"
 #include "cpp/cppmodule.h"
@@ -26,6 +27,7 @@
 #include <string>
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/DeclTemplate.h"
@@ -360,6 +362,7 @@ static void MarkFunctionForEmit(const clang::FunctionDecl *D)
 
     if (!D->getDeclContext()->isDependentContext())
     {
+        TimeTraceScope timeScope("C++ instantiation", [D] { return D->getQualifiedNameAsString(); });
         auto D_ = const_cast<clang::FunctionDecl*>(D);
         
         auto FPT = D_->getType()->getAs<clang::FunctionProtoType>();
@@ -391,6 +394,40 @@ bool isPolymorphic(const clang::RecordDecl *D)
             (CRD->getNumBases() || CRD->isPolymorphic());
 }
 
+// WORKAROUND for https://llvm.org/bugs/show_bug.cgi?id=24420
+// « RecordDecl::LoadFieldsFromExternalStorage() expels existing decls from the DeclContext linked list »
+// This only concerns serialized declarations, which need their fields loaded before Sema adds implicit members
+// to them. Sema may also declare implicit members in the bases and the field records while looking up special members,
+// hence those get loaded as well.
+static llvm::DenseSet<const clang::RecordDecl*> loadedFields; // emptied whenever PCH::AST gets replaced
+
+void forceLoadFields(const clang::RecordDecl *D)
+{
+    if (!D->isCompleteDefinition() && D->getDefinition())
+        D = D->getDefinition();
+    if (!D->isCompleteDefinition() || !loadedFields.insert(D).second)
+        return;
+
+    D->field_begin(); // calls LoadFieldsFromExternalStorage() if needed
+
+    auto forceLoadRecordType = [] (clang::QualType T) {
+        if (auto RT = T->getBaseElementTypeUnsafe()->getAs<clang::RecordType>())
+            forceLoadFields(RT->getDecl());
+    };
+
+    if (auto CRD = dyn_cast<clang::CXXRecordDecl>(D))
+        for (auto& B: CRD->bases())
+            forceLoadRecordType(B.getType());
+
+    for (auto Field: D->fields())
+        forceLoadRecordType(Field->getType());
+}
+
+void clearLoadedFields()
+{
+    loadedFields.clear();
+}
+
 Dsymbols *DeclMapper::VisitRecordDecl(const clang::RecordDecl *D, unsigned flags)
 {
     auto& Context = calypso.getASTContext();
@@ -404,6 +441,7 @@ Dsymbols *DeclMapper::VisitRecordDecl(const clang::RecordDecl *D, unsigned flags
     auto decldefs = new Dsymbols;
     auto loc = fromLoc(D->getLocation());
 
+    forceLoadFields(D);
     if (S.RequireCompleteType(D->getLocation(),
                 Context.getRecordType(D), clang::diag::err_incomplete_type))
         Diags.Reset();
@@ -673,6 +711,7 @@ bool FunctionReferencer::ReferenceRecord(const clang::RecordType *RT)
 
     if (!RD->isDependentType())
     {
+        forceLoadFields(RD);
         if (isPolymorphic(RD))
         {
             auto Ctor = S.LookupDefaultConstructor(
@@ -885,6 +924,19 @@ Dsymbols *DeclMapper::VisitFunctionDecl(const clang::FunctionDecl *D, unsigned f
     {
         fd = new DtorDeclaration(loc, stc, Id::dtor, DD);
     }
+    else if (MD && MD->getOverloadedOperator() == clang::OO_New)
+    {
+        // Class-specific operator new becomes the D allocator of the record, so that new T and new(args) T
+        // from D allocate the memory the same way C++ would
+        fd = new NewDeclaration(loc, stc, tf, D);
+    }
+    else if (MD && MD->getOverloadedOperator() == clang::OO_Delete)
+    {
+        if (FPT->getNumParams() != 1)
+            return nullptr; // D deallocators only take the pointer, sized or placement operator deletes have no equivalent
+
+        fd = new DeleteDeclaration(loc, stc, tf, D);
+    }
     else if (D->isOverloadedOperator() || isa<clang::CXXConversionDecl>(D))
     {
         SpecValue spec(*this);
@@ -1753,6 +1805,8 @@ static void mapClangModule(DeclMapper &mapper,
 
 Module *Module::load(Loc loc, Identifiers *packages, Identifier *id)
 {
+    TimeTraceScope timeScope("C++ import", [id] { return id->toChars(); });
+
     if (!calypso.getASTUnit()) {
         ::error(loc, "Importing a C++ module without specifying C++ headers with modmap");
         fatal();
@@ -15,6 +15,7 @@
 #include "clang/Sema/SemaDiagnostic.h"
 #include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
+#include "llvm/ADT/StringMap.h"
 
 size_t correspondingParamIdx(size_t argi, TemplateDeclaration* tempdecl, Objects* tiargs);
 
@@ -437,8 +438,120 @@ Dsymbols* TemplateDeclaration::copySyntaxTree(::TemplateInstance *ti)
     return ::TemplateDeclaration::copySyntaxTree(ti);
 }
 
+// D overload resolution may probe the same C++ template with the same arguments thousands of times (e.g std::operator<<),
+// so the results of deductions and instantiations are memoized, failures included. The key is built from the D
+// arguments so that a hit doesn't need to map them to Clang types or expressions.
+// The keys and results point into the AST, so the cache is emptied whenever PCH::AST gets replaced.
+static llvm::StringMap<TemplateInstUnion> instCache;
+
+void clearInstCache()
+{
+    instCache.clear();
+}
+
+static bool appendInstKey(OutBuffer& buf, RootObject* o)
+{
+    if (auto t = isType(o))
+    {
+        if (!t->deco)
+            return false;
+        buf.printf("T%s;", t->deco);
+    }
+    else if (auto e = isExpression(o))
+    {
+        if (!e->type || !e->type->deco)
+            return false;
+        switch (e->op)
+        {
+            case TOKint64:
+                buf.printf("I%s:%llu;", e->type->deco, (ulonglong)e->toInteger());
+                break;
+            case TOKfloat64:
+            case TOKstring:
+            case TOKnull:
+                buf.printf("E%s:%s;", e->type->deco, e->toChars());
+                break;
+            default:
+                return false; // may depend on the scope
+        }
+    }
+    else if (auto s = isDsymbol(o))
+        buf.printf("S%p;", (void*)s);
+    else if (auto tup = isTuple(o))
+    {
+        buf.writeByte('(');
+        for (auto o2: tup->objects)
+            if (!appendInstKey(buf, o2))
+                return false;
+        buf.writeByte(')');
+    }
+    else
+        return false;
+
+    return true;
+}
+
+// Returns false if one of the arguments can't be part of a key
+static bool makeInstKey(OutBuffer& buf, char kind, const clang::Decl* Temp, Objects* tiargs, Expressions* fargs = nullptr)
+{
+    buf.printf("%c%p:", kind, (void*)Temp->getCanonicalDecl());
+
+    if (tiargs)
+        for (auto o: *tiargs)
+            if (!appendInstKey(buf, o))
+                return false;
+
+    if (fargs)
+    {
+        buf.writeByte('|');
+        for (auto farg: *fargs)
+        {
+            if (!farg->type || !farg->type->deco)
+                return false;
+            buf.printf("%s%c;", farg->type->deco, farg->isLvalue() ? 'L' : 'R');
+        }
+    }
+
+    return true;
+}
+
+static inline llvm::StringRef instKeyRef(OutBuffer& buf)
+{
+    return llvm::StringRef((const char*)buf.data, buf.offset);
+}
+
+static void logInstCacheHit(::TemplateInstance* ti)
+{
+    if (global.params.verbose)
+        fprintf(global.stdmsg, "cppinst   %s (memoized)\n", ti->toChars());
+}
+
 MATCH TemplateDeclaration::functionTemplateMatch(::TemplateInstance *ti, Expressions *fargs,
                                                  TemplateInstUnion& Inst)
+{
+    auto FunctionTemplate = cast<clang::FunctionTemplateDecl>(TempOrSpec); // probably going to fail epxlicit spec
+
+    OutBuffer key;
+    bool cacheable = makeInstKey(key, 'F', FunctionTemplate, ti->tiargs, fargs);
+    if (cacheable)
+    {
+        auto Cached = instCache.find(instKeyRef(key));
+        if (Cached != instCache.end())
+        {
+            logInstCacheHit(ti);
+            Inst = Cached->second;
+            return Inst ? MATCHexact : MATCHnomatch;
+        }
+    }
+
+    Inst = functionTemplateDeduce(ti, fargs);
+
+    if (cacheable)
+        instCache[instKeyRef(key)] = Inst;
+    return Inst ? MATCHexact : MATCHnomatch;
+}
+
+TemplateInstUnion TemplateDeclaration::functionTemplateDeduce(::TemplateInstance *ti, Expressions *fargs)
 {
     auto& Context = calypso.getASTContext();
     auto& S = calypso.getSema();
@@ -475,10 +588,9 @@ MATCH TemplateDeclaration::functionTemplateMatch(::TemplateInstance *ti, Express
 
     if (S.DeduceTemplateArguments(const_cast<clang::FunctionTemplateDecl*>(FunctionTemplate),
                     &ExplicitTemplateArgs, Args, Specialization, DedInfo))
-        return MATCHnomatch;
+        return TemplateInstUnion();
 
-    Inst = Specialization;
-    return MATCHexact;
+    return Specialization;
 }
 
 MATCH TemplateDeclaration::deduceFunctionTemplateMatch(::TemplateInstance *ti, Scope *sc, ::FuncDeclaration *&fd,
@@ -624,18 +736,40 @@ TemplateInstUnion TemplateDeclaration::getClangInst(Scope* sc, ::TemplateInstanc
     if (auto existingInst = hasExistingClangInst(ti))
         return existingInst;
 
-    auto& S = calypso.getSema();
-
-    TypeMapper tymap;
-    ExprMapper expmap(tymap);
-    tymap.addImplicitDecls = false;
-
     auto Temp = const_cast<clang::RedeclarableTemplateDecl*>
                                 (getDefinition(getPrimaryTemplate() /*,false*/)); // TODO: remove lookIntoMemberTemplate dead code
 
     if (!tdtypes)
         tdtypes = &ti->tdtypes;
 
+    OutBuffer key;
+    bool cacheable = makeInstKey(key, 'I', Temp, tdtypes);
+    if (cacheable)
+    {
+        auto Cached = instCache.find(instKeyRef(key));
+        // Failures are only skipped while gagged, otherwise the instantiation is redone to report the errors
+        if (Cached != instCache.end() && (Cached->second || global.gag))
+        {
+            logInstCacheHit(ti);
+            return Cached->second;
+        }
+    }
+
+    auto Inst = instantiate(sc, Temp, tdtypes);
+
+    if (cacheable)
+        instCache[instKeyRef(key)] = Inst;
+    return Inst;
+}
+
+TemplateInstUnion TemplateDeclaration::instantiate(Scope* sc, clang::RedeclarableTemplateDecl* Temp, Objects* tdtypes)
+{
+    auto& S = calypso.getSema();
+
+    TypeMapper tymap;
+    ExprMapper expmap(tymap);
+    tymap.addImplicitDecls = false;
+
     clang::TemplateArgumentListInfo Args;
     fillTemplateArgumentListInfo(loc, sc, Args, tdtypes, Temp, tymap, expmap);
 
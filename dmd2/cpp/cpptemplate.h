@@ -22,6 +22,8 @@ class TemplateInstance;
 
 using TemplateInstUnion = llvm::PointerUnion<clang::NamedDecl*, const clang::TemplateSpecializationType*>;
 
+void clearInstCache(); // forget the memoized deductions and instantiations, which belong to the previous AST
+
 class TemplateDeclaration : public ::TemplateDeclaration
 {
 public:
@@ -43,7 +45,8 @@ public:
     Dsymbols* copySyntaxTree(::TemplateInstance *ti) override;
     MATCH deduceFunctionTemplateMatch(::TemplateInstance *ti, Scope *sc, ::FuncDeclaration *&fd, Type *tthis, Expressions *fargs) override;
 
-    MATCH functionTemplateMatch(::TemplateInstance *ti, Expressions *fargs, TemplateInstUnion& Inst);
+    MATCH functionTemplateMatch(::TemplateInstance *ti, Expressions *fargs, TemplateInstUnion& Inst); // memoized
+    TemplateInstUnion functionTemplateDeduce(::TemplateInstance *ti, Expressions *fargs);
 
     Objects* tdtypesFromInst(TemplateInstUnion Inst, bool forForeignInstance = false);
 
@@ -51,7 +54,8 @@ public:
     void makeForeignInstance( cpp::TemplateInstance* ti );
 
     TemplateInstUnion hasExistingClangInst(::TemplateInstance* ti);
-    TemplateInstUnion getClangInst(Scope* sc, ::TemplateInstance* ti, Objects* tdtypes = nullptr);
+    TemplateInstUnion getClangInst(Scope* sc, ::TemplateInstance* ti, Objects* tdtypes = nullptr); // memoized
+    TemplateInstUnion instantiate(Scope* sc, clang::RedeclarableTemplateDecl* Temp, Objects* tdtypes);
     clang::RedeclarableTemplateDecl *getPrimaryTemplate();
     TemplateDeclaration *primaryTemplate();
     static bool isForeignInstance(::TemplateInstance *ti);
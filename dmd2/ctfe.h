@@ -19,6 +19,9 @@
 #include "arraytypes.h"
 #include "tokens.h"
 
+// Maximum allowable recursive function calls in CTFE
+#define CTFE_RECURSION_LIMIT 1000
+
 /**
    Global status of the CTFE engine. Mostly used for performance diagnostics
  */
@@ -31,6 +34,9 @@ struct CtfeStatus
     static int maxCallDepth; // highest number of recursive calls
     static int numArrayAllocs; // Number of allocated arrays
     static int numAssignments; // total number of assignments executed
+#if IN_LLVM
+    static int numMemoizedCalls; // pure function calls answered from the memoization table
+#endif
 };
 
 /**
@@ -276,5 +282,53 @@ Expression *ctfeIndex(Loc loc, Type *type, Expression *e1, uinteger_t indx);
 /// Cast 'e' of type 'type' to type 'to'.
 Expression *ctfeCast(Loc loc, Type *type, Type *to, Expression *e);
 
+#if IN_LLVM
+/**
+  Memory arena for the temporary values of a top-level CTFE evaluation,
+  only used with -ctfe-release-memory. While an arena is current,
+  Expressions are allocated from it. finish() copies the result out and
+  frees everything else at once.
+ */
+struct CtfeArena
+{
+    static CtfeArena *current; // arena Expressions are allocated from, or NULL
+    static size_t memoryInUse; // bytes of all the chunks not freed yet
+    static size_t peakMemory;  // highest memoryInUse
+
+    CtfeArena();
+    void *alloc(size_t size);
+    /// Make the enclosing arena current again, copy result out of this
+    /// arena and release it. Returns the copy.
+    Expression *finish(Expression *result);
+
+    /// Return true if p was allocated from an arena
+    static bool owns(void *p);
+
+private:
+    CtfeArena *prev;
+    char *ptr;
+    size_t left;
+};
+
+/**
+  Suspends the current CTFE arena for the lifetime of the object. Needed
+  around anything whose results outlive the CTFE evaluation, e.g. semantic
+  analysis or types merged into the type table.
+ */
+struct CtfeArenaSuspend
+{
+    CtfeArena *saved;
+
+    CtfeArenaSuspend() : saved(CtfeArena::current) { CtfeArena::current = NULL; }
+    ~CtfeArenaSuspend() { CtfeArena::current = saved; }
+};
+
+class FuncDeclaration;
+
+/// Run a call to fd with interpreted arguments using the bytecode engine.
+/// Returns NULL if fd or the call isn't supported by the bytecode engine.
+Expression *ctfeBytecodeInterpret(FuncDeclaration *fd, Expressions *arguments);
+#endif
+
 
 #endif /* DMD_CTFE_H */
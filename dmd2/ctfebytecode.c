@@ -0,0 +1,1055 @@
+/* Compiler implementation of the D programming language
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/* Bytecode CTFE engine (-ctfe-bytecode).
+ *
+ * Functions working only on integral values (integers, bool, characters
+ * and enums of those) are lowered to a compact register bytecode the first
+ * time they are called at compile time, and then run without creating a
+ * single Expression.
+ *
+ * Anything the compiler doesn't handle makes it give up on the function,
+ * and anything unusual at run time (division by zero, out of range shift,
+ * failed assert, throw, recursion limit) makes the VM bail out. In both
+ * cases the call is done again by the tree interpreter, which also takes
+ * care of the error messages. Since bytecode functions can only read and
+ * write their own registers, re-running a call from scratch is always safe.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rmem.h"
+#include "aav.h"
+
+#include "statement.h"
+#include "expression.h"
+#include "declaration.h"
+#include "init.h"
+#include "mtype.h"
+#include "id.h"
+#include "visitor.h"
+#include "ctfe.h"
+
+enum BcOp
+{
+    BCimm,      // r[a] = consts[b]
+    BCmov,      // r[a] = r[b]
+    BCadd,      // r[a] = r[b] op r[c], normalized to kind
+    BCsub,
+    BCmul,
+    BCdiv,      // signed or unsigned depending on 'uns'
+    BCmod,
+    BCand,
+    BCor,
+    BCxor,
+    BCshl,      // 'width' is the size of the left operand in bits
+    BCshr,
+    BCushr,
+    BCneg,      // r[a] = op r[b], normalized to kind
+    BCcom,
+    BCnot,
+    BCnorm,     // r[a] = r[b], normalized to kind
+    BCeq,       // r[a] = r[b] op r[c]
+    BCne,
+    BClt,       // signed or unsigned depending on 'uns'
+    BCle,
+    BCjmp,      // goto a
+    BCjz,       // if (!r[b]) goto a
+    BCjnz,      // if (r[b]) goto a
+    BCcall,     // r[a] = callees[c](r[b] .. r[b + nargs - 1])
+    BCret,      // return r[a]
+    BCfail,     // give up, let the tree interpreter redo the call
+};
+
+/* How to normalize a value to its type, see IntegerExp::normalize()
+ */
+enum BcKind
+{
+    BKbool,
+    BKint8,
+    BKuns8,
+    BKint16,
+    BKuns16,
+    BKint32,
+    BKuns32,
+    BKint64,
+    BKuns64,
+};
+
+struct BcInsn
+{
+    unsigned char op;
+    unsigned char kind;
+    unsigned char uns;
+    unsigned char width;
+    int a, b, c;
+};
+
+struct BcFunction
+{
+    FuncDeclaration *fd;
+    bool ok;                    // false if the function couldn't be compiled
+    bool compiling;             // true while compiling the function itself
+    int nparams;
+    int nregs;
+    unsigned char resultKind;
+    Array<BcInsn> code;
+    Array<sinteger_t> consts;
+    Array<BcFunction *> callees;
+
+    BcFunction(FuncDeclaration *fd)
+        : fd(fd), ok(false), compiling(true), nparams(0), nregs(0), resultKind(BKint32)
+    {
+    }
+};
+
+static AA *bcFunctions = NULL;
+
+static bool toBcKind(Type *t, unsigned char *kind)
+{
+    switch (t->toBasetype()->ty)
+    {
+        case Tbool:                     *kind = BKbool;  return true;
+        case Tint8:                     *kind = BKint8;  return true;
+        case Tchar:   case Tuns8:       *kind = BKuns8;  return true;
+        case Tint16:                    *kind = BKint16; return true;
+        case Twchar:  case Tuns16:      *kind = BKuns16; return true;
+        case Tint32:                    *kind = BKint32; return true;
+        case Tdchar:  case Tuns32:      *kind = BKuns32; return true;
+        case Tint64:                    *kind = BKint64; return true;
+        case Tuns64:                    *kind = BKuns64; return true;
+        default:
+            return false;
+    }
+}
+
+static bool isBcType(Type *t)
+{
+    unsigned char kind;
+    return t && toBcKind(t, &kind);
+}
+
+static bool isUnsignedKind(unsigned kind)
+{
+    return kind == BKbool || kind == BKuns8 || kind == BKuns16 ||
+           kind == BKuns32 || kind == BKuns64;
+}
+
+static unsigned kindWidth(unsigned kind)
+{
+    switch (kind)
+    {
+        case BKbool:
+        case BKint8:    case BKuns8:    return 8;
+        case BKint16:   case BKuns16:   return 16;
+        case BKint32:   case BKuns32:   return 32;
+        default:                        return 64;
+    }
+}
+
+/* Kind of the integral promotion of a value of kind
+ */
+static unsigned char promotedKind(unsigned char kind)
+{
+    return kindWidth(kind) < 32 ? BKint32 : kind;
+}
+
+/* Whether an arithmetic operation on values of kind1 and kind2 is unsigned,
+ * i.e. whether the common type of their integral promotions is
+ */
+static bool isUnsignedOp(unsigned char kind1, unsigned char kind2)
+{
+    kind1 = promotedKind(kind1);
+    kind2 = promotedKind(kind2);
+    if (kindWidth(kind1) != kindWidth(kind2))
+        return isUnsignedKind(kindWidth(kind1) > kindWidth(kind2) ? kind1 : kind2);
+    return isUnsignedKind(kind1) || isUnsignedKind(kind2);
+}
+
+static inline sinteger_t normalize(dinteger_t v, unsigned kind)
+{
+    switch (kind)
+    {
+        case BKbool:    return v != 0;
+        case BKint8:    return (d_int8) v;
+        case BKuns8:    return (d_uns8) v;
+        case BKint16:   return (d_int16) v;
+        case BKuns16:   return (d_uns16) v;
+        case BKint32:   return (d_int32) v;
+        case BKuns32:   return (d_uns32) v;
+        default:        return (sinteger_t) v;
+    }
+}
+
+/************** Compiler ********************************************/
+
+static BcFunction *bcCompile(FuncDeclaration *fd);
+
+/* Jumps to patch at the end of the innermost loop
+ */
+struct BcLoop
+{
+    Array<size_t> breaks;
+    Array<size_t> continues;
+};
+
+class BcCompiler : public Visitor
+{
+public:
+    BcFunction *bf;
+    bool failed;
+    int result;                         // register holding the value of the last expression, -1 if none
+    Array<VarDeclaration *> vars;       // vars[i] lives in register i
+    Array<BcLoop *> loops;
+
+    BcCompiler(BcFunction *bf)
+        : bf(bf), failed(false), result(-1)
+    {
+    }
+
+    int newReg()
+    {
+        vars.push(NULL);
+        return bf->nregs++;
+    }
+
+    int newVar(VarDeclaration *v)
+    {
+        int r = newReg();
+        vars[r] = v;
+        return r;
+    }
+
+    int findVar(VarDeclaration *v)
+    {
+        for (size_t i = 0; i < vars.dim; i++)
+        {
+            if (vars[i] == v)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    size_t emit(BcOp op, int a, int b = 0, int c = 0, unsigned char kind = BKint64,
+                unsigned char uns = 0, unsigned char width = 64)
+    {
+        BcInsn insn;
+        insn.op = (unsigned char)op;
+        insn.kind = kind;
+        insn.uns = uns;
+        insn.width = width;
+        insn.a = a;
+        insn.b = b;
+        insn.c = c;
+        bf->code.push(insn);
+        return bf->code.dim - 1;
+    }
+
+    void patch(size_t insn)
+    {
+        bf->code[insn].a = (int)bf->code.dim;
+    }
+
+    int loadConstant(sinteger_t value)
+    {
+        int r = newReg();
+        emit(BCimm, r, (int)bf->consts.dim);
+        bf->consts.push(value);
+        return r;
+    }
+
+    /* Compile e, and return the register holding its value, or -1
+     * if it doesn't have one (or the compilation failed).
+     */
+    int compileExp(Expression *e)
+    {
+        if (failed)
+            return -1;
+        result = -1;
+        e->accept(this);
+        return failed ? -1 : result;
+    }
+
+    int compileValue(Expression *e)
+    {
+        int r = compileExp(e);
+        if (r < 0)
+            failed = true;
+        return r;
+    }
+
+    void compileStatement(Statement *s)
+    {
+        if (s && !failed)
+            s->accept(this);
+    }
+
+    bool checkKind(Expression *e, unsigned char *kind)
+    {
+        if (!toBcKind(e->type, kind))
+            failed = true;
+        return !failed;
+    }
+
+    /* Register of the local variable e refers to, or -1
+     */
+    int lvalueReg(Expression *e)
+    {
+        if (e->op != TOKvar)
+            return -1;
+        VarDeclaration *v = ((VarExp *)e)->var->isVarDeclaration();
+        if (!v || v->storage_class & (STCref | STCout | STClazy))
+            return -1;
+        return findVar(v);
+    }
+
+    /* Arithmetic and bitwise operators, shared by BinExp and BinAssignExp
+     */
+    void binaryOp(TOK op, int dst, int r1, int r2, Expression *e1, Expression *e2, Type *type)
+    {
+        unsigned char kind, kind1, kind2;
+        if (!toBcKind(type, &kind) || !toBcKind(e1->type, &kind1) || !toBcKind(e2->type, &kind2))
+        {
+            failed = true;
+            return;
+        }
+        unsigned char uns = isUnsignedOp(kind1, kind2);
+        switch (op)
+        {
+            case TOKadd:  case TOKaddass:   emit(BCadd, dst, r1, r2, kind);     break;
+            case TOKmin:  case TOKminass:   emit(BCsub, dst, r1, r2, kind);     break;
+            case TOKmul:  case TOKmulass:   emit(BCmul, dst, r1, r2, kind);     break;
+            case TOKdiv:  case TOKdivass:   emit(BCdiv, dst, r1, r2, kind, uns); break;
+            case TOKmod:  case TOKmodass:   emit(BCmod, dst, r1, r2, kind, uns); break;
+            case TOKand:  case TOKandass:   emit(BCand, dst, r1, r2, kind);     break;
+            case TOKor:   case TOKorass:    emit(BCor, dst, r1, r2, kind);      break;
+            case TOKxor:  case TOKxorass:   emit(BCxor, dst, r1, r2, kind);     break;
+            case TOKshl:  case TOKshlass:
+                emit(BCshl, dst, r1, r2, kind, isUnsignedKind(kind1), kindWidth(kind1));
+                break;
+            case TOKshr:  case TOKshrass:
+                emit(BCshr, dst, r1, r2, kind, isUnsignedKind(kind1), kindWidth(kind1));
+                break;
+            case TOKushr: case TOKushrass:
+                emit(BCushr, dst, r1, r2, kind, isUnsignedKind(kind1), kindWidth(kind1));
+                break;
+            default:
+                failed = true;
+                break;
+        }
+    }
+
+    /* Emit a conditional jump on e, to be patched later
+     */
+    size_t compileCondJump(Expression *e, bool jumpIfTrue)
+    {
+        unsigned char kind;
+        if (!checkKind(e, &kind))
+            return 0;
+        int r = compileValue(e);
+        if (failed)
+            return 0;
+        return emit(jumpIfTrue ? BCjnz : BCjz, 0, r);
+    }
+
+    void pushLoop()
+    {
+        loops.push(new BcLoop());
+    }
+
+    void popLoop(size_t continueTarget)
+    {
+        BcLoop *loop = loops.pop();
+        for (size_t i = 0; i < loop->continues.dim; i++)
+            bf->code[loop->continues[i]].a = (int)continueTarget;
+        for (size_t i = 0; i < loop->breaks.dim; i++)
+            patch(loop->breaks[i]);
+        delete loop;
+    }
+
+    /*********************** Statements ***********************/
+
+    void visit(Statement *s)
+    {
+        failed = true;
+    }
+
+    void visit(ExpStatement *s)
+    {
+        if (s->exp)
+            compileExp(s->exp);
+    }
+
+    void visit(DtorExpStatement *s)
+    {
+        failed = true;
+    }
+
+    void visit(CompoundStatement *s)
+    {
+        for (size_t i = 0; i < s->statements->dim && !failed; i++)
+            compileStatement((*s->statements)[i]);
+    }
+
+    void visit(ScopeStatement *s)
+    {
+        compileStatement(s->statement);
+    }
+
+    void visit(IfStatement *s)
+    {
+        if (s->match)
+        {
+            failed = true;
+            return;
+        }
+        size_t jelse = compileCondJump(s->condition, false);
+        compileStatement(s->ifbody);
+        if (failed)
+            return;
+        if (s->elsebody)
+        {
+            size_t jend = emit(BCjmp, 0);
+            patch(jelse);
+            compileStatement(s->elsebody);
+            patch(jend);
+        }
+        else
+            patch(jelse);
+    }
+
+    void visit(WhileStatement *s)
+    {
+        // Lowered to a ForStatement by the semantic pass
+        failed = true;
+    }
+
+    void visit(ForStatement *s)
+    {
+        compileStatement(s->init);
+        if (failed)
+            return;
+
+        size_t start = bf->code.dim;
+        size_t jend = 0;
+        bool hasCond = s->condition != NULL;
+        if (hasCond)
+            jend = compileCondJump(s->condition, false);
+        if (failed)
+            return;
+
+        pushLoop();
+        compileStatement(s->body);
+        size_t next = bf->code.dim;
+        if (s->increment)
+            compileExp(s->increment);
+        emit(BCjmp, (int)start);
+        if (hasCond)
+            patch(jend);
+        popLoop(next);
+    }
+
+    void visit(DoStatement *s)
+    {
+        size_t start = bf->code.dim;
+        pushLoop();
+        compileStatement(s->body);
+        size_t next = bf->code.dim;
+        if (!failed)
+        {
+            size_t jstart = compileCondJump(s->condition, true);
+            if (!failed)
+                bf->code[jstart].a = (int)start;
+        }
+        popLoop(next);
+    }
+
+    void visit(BreakStatement *s)
+    {
+        if (s->ident || !loops.dim)
+        {
+            failed = true;
+            return;
+        }
+        loops[loops.dim - 1]->breaks.push(emit(BCjmp, 0));
+    }
+
+    void visit(ContinueStatement *s)
+    {
+        if (s->ident || !loops.dim)
+        {
+            failed = true;
+            return;
+        }
+        loops[loops.dim - 1]->continues.push(emit(BCjmp, 0));
+    }
+
+    void visit(ReturnStatement *s)
+    {
+        if (!s->exp)
+        {
+            failed = true;
+            return;
+        }
+        int r = compileValue(s->exp);
+        if (!failed)
+            emit(BCret, r);
+    }
+
+    void visit(ThrowStatement *s)
+    {
+        // The tree interpreter deals with exceptions
+        emit(BCfail, 0);
+    }
+
+    /*********************** Expressions ***********************/
+
+    void visit(Expression *e)
+    {
+        failed = true;
+    }
+
+    void visit(IntegerExp *e)
+    {
+        unsigned char kind;
+        if (checkKind(e, &kind))
+            result = loadConstant(normalize(e->toInteger(), kind));
+    }
+
+    void visit(VarExp *e)
+    {
+        VarDeclaration *v = e->var->isVarDeclaration();
+        if (v && v->ident == Id::ctfe)
+        {
+            result = loadConstant(1);
+            return;
+        }
+        unsigned char kind;
+        if (!checkKind(e, &kind))
+            return;
+        int rv = lvalueReg(e);
+        if (rv < 0)
+        {
+            failed = true;      // globals, outer function variables, ...
+            return;
+        }
+        // Copy it, later side effects in the same expression mustn't
+        // change the value read here
+        result = newReg();
+        emit(BCmov, result, rv);
+    }
+
+    void visit(DeclarationExp *e)
+    {
+        VarDeclaration *v = e->declaration->isVarDeclaration();
+        if (!v || v->toAlias() != v)
+        {
+            failed = true;
+            return;
+        }
+        if (v->storage_class & STCmanifest)
+            return;
+        if (v->isDataseg() || v->storage_class & (STCref | STCout | STClazy) ||
+            !isBcType(v->type) || !v->init)
+        {
+            failed = true;
+            return;
+        }
+        ExpInitializer *ie = v->init->isExpInitializer();
+        if (!ie)
+        {
+            failed = true;
+            return;
+        }
+        int r = newVar(v);
+        int ri = compileExp(ie->exp);
+        if (!failed && ri >= 0 && ri != r)
+        {
+            // Initializer not lowered to a construction
+            emit(BCmov, r, ri);
+        }
+        result = r;
+    }
+
+    void visit(CastExp *e)
+    {
+        unsigned char kind, kind1;
+        if (!checkKind(e, &kind) || !checkKind(e->e1, &kind1))
+            return;
+        int r1 = compileValue(e->e1);
+        if (failed)
+            return;
+        if (kind == kind1)
+        {
+            result = r1;
+            return;
+        }
+        result = newReg();
+        emit(BCnorm, result, r1, 0, kind);
+    }
+
+    void unaryOp(UnaExp *e, BcOp op)
+    {
+        unsigned char kind, kind1;
+        if (!checkKind(e, &kind) || !checkKind(e->e1, &kind1))
+            return;
+        int r1 = compileValue(e->e1);
+        if (failed)
+            return;
+        result = newReg();
+        emit(op, result, r1, 0, kind);
+    }
+
+    void visit(NegExp *e) { unaryOp(e, BCneg); }
+    void visit(ComExp *e) { unaryOp(e, BCcom); }
+    void visit(NotExp *e) { unaryOp(e, BCnot); }
+
+    void visit(BinExp *e)
+    {
+        int r1 = compileValue(e->e1);
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        result = newReg();
+        binaryOp(e->op, result, r1, r2, e->e1, e->e2, e->type);
+    }
+
+    void compare(BinExp *e, BcOp op, bool swap)
+    {
+        unsigned char kind, kind1, kind2;
+        if (!checkKind(e, &kind) || !checkKind(e->e1, &kind1) || !checkKind(e->e2, &kind2))
+            return;
+        int r1 = compileValue(e->e1);
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        result = newReg();
+        emit(op, result, swap ? r2 : r1, swap ? r1 : r2, BKbool, isUnsignedKind(kind1));
+    }
+
+    void visit(EqualExp *e)
+    {
+        compare(e, e->op == TOKequal ? BCeq : BCne, false);
+    }
+
+    void visit(IdentityExp *e)
+    {
+        compare(e, e->op == TOKidentity ? BCeq : BCne, false);
+    }
+
+    void visit(CmpExp *e)
+    {
+        switch (e->op)
+        {
+            case TOKlt: compare(e, BClt, false); break;
+            case TOKle: compare(e, BCle, false); break;
+            case TOKgt: compare(e, BClt, true);  break;
+            case TOKge: compare(e, BCle, true);  break;
+            default:
+                failed = true;
+                break;
+        }
+    }
+
+    void logicalOp(BinExp *e, bool isOrOr)
+    {
+        unsigned char kind;
+        if (!checkKind(e, &kind) || kind != BKbool)
+        {
+            failed = true;
+            return;
+        }
+        int r = newReg();
+        int r1 = compileValue(e->e1);
+        if (failed)
+            return;
+        emit(BCnorm, r, r1, 0, BKbool);
+        size_t jend = emit(isOrOr ? BCjnz : BCjz, 0, r);
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        emit(BCnorm, r, r2, 0, BKbool);
+        patch(jend);
+        result = r;
+    }
+
+    void visit(AndAndExp *e) { logicalOp(e, false); }
+    void visit(OrOrExp *e) { logicalOp(e, true); }
+
+    void visit(CondExp *e)
+    {
+        unsigned char kind;
+        if (!checkKind(e, &kind))
+            return;
+        int r = newReg();
+        size_t jelse = compileCondJump(e->econd, false);
+        int r1 = compileValue(e->e1);
+        if (failed)
+            return;
+        emit(BCmov, r, r1);
+        size_t jend = emit(BCjmp, 0);
+        patch(jelse);
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        emit(BCmov, r, r2);
+        patch(jend);
+        result = r;
+    }
+
+    void visit(CommaExp *e)
+    {
+        compileExp(e->e1);
+        if (!failed)
+            result = compileExp(e->e2);
+    }
+
+    void visit(AssignExp *e)
+    {
+        int dst = lvalueReg(e->e1);
+        unsigned char kind;
+        if (dst < 0 || !checkKind(e->e1, &kind) || !checkKind(e->e2, &kind))
+        {
+            failed = true;
+            return;
+        }
+        int r = compileValue(e->e2);
+        if (failed)
+            return;
+        emit(BCmov, dst, r);
+        result = newReg();
+        emit(BCmov, result, dst);
+    }
+
+    void visit(BinAssignExp *e)
+    {
+        /* The semantic pass types e.g. a /= b with a ubyte and b an int as
+         * cast(int)a /= b. Like codegen, compute in the promoted type, except
+         * for shifts which use the type of the variable.
+         */
+        Expression *lval = e->e1;
+        while (lval->op == TOKcast)
+            lval = ((CastExp *)lval)->e1;
+        int dst = lvalueReg(lval);
+        unsigned char kind, opKind;
+        if (dst < 0 || !checkKind(lval, &kind) || !checkKind(e->e1, &opKind))
+        {
+            failed = true;
+            return;
+        }
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        if (e->op == TOKshlass || e->op == TOKshrass || e->op == TOKushrass)
+            binaryOp(e->op, dst, dst, r2, lval, e->e2, lval->type);
+        else
+        {
+            int r1 = dst;
+            if (opKind != kind)
+            {
+                r1 = newReg();
+                emit(BCnorm, r1, dst, 0, opKind);
+            }
+            binaryOp(e->op, dst, r1, r2, e->e1, e->e2, lval->type);
+        }
+        result = newReg();
+        emit(BCmov, result, dst);
+    }
+
+    void visit(PostExp *e)
+    {
+        int dst = lvalueReg(e->e1);
+        unsigned char kind;
+        if (dst < 0 || !checkKind(e->e1, &kind))
+        {
+            failed = true;
+            return;
+        }
+        int r2 = compileValue(e->e2);
+        if (failed)
+            return;
+        result = newReg();
+        emit(BCmov, result, dst);
+        binaryOp(e->op == TOKplusplus ? TOKadd : TOKmin, dst, dst, r2, e->e1, e->e2, e->e1->type);
+    }
+
+    void visit(AssertExp *e)
+    {
+        size_t jok = compileCondJump(e->e1, true);
+        if (failed)
+            return;
+        emit(BCfail, 0);
+        patch(jok);
+    }
+
+    void visit(HaltExp *e)
+    {
+        emit(BCfail, 0);
+    }
+
+    void visit(CallExp *e)
+    {
+        unsigned char kind;
+        if (!checkKind(e, &kind) || e->e1->op != TOKvar)
+        {
+            failed = true;
+            return;
+        }
+        FuncDeclaration *f = ((VarExp *)e->e1)->var->isFuncDeclaration();
+        if (!f)
+        {
+            failed = true;
+            return;
+        }
+        BcFunction *callee = bcCompile(f);
+        if (!callee)
+        {
+            failed = true;
+            return;
+        }
+        size_t nargs = e->arguments ? e->arguments->dim : 0;
+        if ((int)nargs != callee->nparams)
+        {
+            failed = true;
+            return;
+        }
+
+        // Arguments go into consecutive registers
+        Array<int> rargs;
+        rargs.setDim(nargs);
+        for (size_t i = 0; i < nargs && !failed; i++)
+            rargs[i] = compileValue((*e->arguments)[i]);
+        if (failed)
+            return;
+        int first = bf->nregs;
+        for (size_t i = 0; i < nargs; i++)
+            emit(BCmov, newReg(), rargs[i]);
+        result = newReg();
+        emit(BCcall, result, first, (int)bf->callees.dim);
+        bf->callees.push(callee);
+    }
+};
+
+/* Return the bytecode of fd, compiling it if needed, or NULL if it
+ * can't be compiled.
+ */
+static BcFunction *bcCompile(FuncDeclaration *fd)
+{
+    BcFunction **pbf = (BcFunction **)dmd_aaGet(&bcFunctions, (void *)fd);
+    if (*pbf)
+    {
+        // Recursive calls get the function being compiled, its 'ok'
+        // is checked when calling it.
+        return (*pbf)->ok || (*pbf)->compiling ? *pbf : NULL;
+    }
+
+    BcFunction *bf = new BcFunction(fd);
+    *pbf = bf;
+
+    if (fd->semanticRun == PASSsemantic3 || !fd->functionSemantic3() ||
+        fd->semanticRun < PASSsemantic3done || fd->semantic3Errors)
+        goto Lfail;
+    if (!fd->fbody || fd->needThis() || fd->isNested() || fd->vresult ||
+        isBuiltin(fd) == BUILTINyes)
+        goto Lfail;
+
+    {
+        Type *tb = fd->type->toBasetype();
+        if (tb->ty != Tfunction)
+            goto Lfail;
+        TypeFunction *tf = (TypeFunction *)tb;
+        if (tf->varargs || tf->isref || !toBcKind(tf->next, &bf->resultKind))
+            goto Lfail;
+
+        BcCompiler v(bf);
+        size_t dim = fd->parameters ? fd->parameters->dim : 0;
+        for (size_t i = 0; i < dim; i++)
+        {
+            VarDeclaration *p = (*fd->parameters)[i];
+            Parameter *fparam = Parameter::getNth(tf->parameters, i);
+            if (fparam->storageClass & (STCout | STCref | STClazy) || !isBcType(p->type))
+                goto Lfail;
+            v.newVar(p);
+        }
+        bf->nparams = (int)dim;
+
+        v.compileStatement(fd->fbody);
+        if (v.failed)
+            goto Lfail;
+        // Falling off the end of the function
+        v.emit(BCfail, 0);
+    }
+
+    bf->ok = true;
+    bf->compiling = false;
+    return bf;
+
+Lfail:
+    bf->ok = false;
+    bf->compiling = false;
+    bf->code.setDim(0);
+    return NULL;
+}
+
+/************** Interpreter ********************************************/
+
+static sinteger_t *bcStack = NULL;
+static size_t bcStackSize = 0;
+
+static void reserveStack(size_t size)
+{
+    if (size > bcStackSize)
+    {
+        bcStackSize = size * 2 + 256;
+        bcStack = (sinteger_t *)mem.xrealloc(bcStack, bcStackSize * sizeof(sinteger_t));
+    }
+}
+
+/* Run bf with its arguments in bcStack[base .. base + nparams - 1].
+ * Return false if the tree interpreter must take over.
+ */
+static bool bcExecute(BcFunction *bf, size_t base, int depth, sinteger_t *presult)
+{
+    if (!bf->ok || depth > CTFE_RECURSION_LIMIT)
+        return false;
+    reserveStack(base + bf->nregs);
+
+    BcInsn *code = bf->code.tdata();
+    size_t pc = 0;
+    while (1)
+    {
+        BcInsn *i = &code[pc++];
+        // The stack may move during calls
+        sinteger_t *r = bcStack + base;
+        switch (i->op)
+        {
+            case BCimm:     r[i->a] = bf->consts[i->b];                                             break;
+            case BCmov:     r[i->a] = r[i->b];                                                      break;
+            case BCadd:     r[i->a] = normalize((dinteger_t)r[i->b] + (dinteger_t)r[i->c], i->kind); break;
+            case BCsub:     r[i->a] = normalize((dinteger_t)r[i->b] - (dinteger_t)r[i->c], i->kind); break;
+            case BCmul:     r[i->a] = normalize((dinteger_t)r[i->b] * (dinteger_t)r[i->c], i->kind); break;
+            case BCand:     r[i->a] = normalize(r[i->b] & r[i->c], i->kind);                        break;
+            case BCor:      r[i->a] = normalize(r[i->b] | r[i->c], i->kind);                        break;
+            case BCxor:     r[i->a] = normalize(r[i->b] ^ r[i->c], i->kind);                        break;
+            case BCneg:     r[i->a] = normalize(-(dinteger_t)r[i->b], i->kind);                     break;
+            case BCcom:     r[i->a] = normalize(~r[i->b], i->kind);                                 break;
+            case BCnot:     r[i->a] = r[i->b] == 0;                                                 break;
+            case BCnorm:    r[i->a] = normalize(r[i->b], i->kind);                                  break;
+            case BCeq:      r[i->a] = r[i->b] == r[i->c];                                           break;
+            case BCne:      r[i->a] = r[i->b] != r[i->c];                                           break;
+
+            case BCdiv:
+            case BCmod:
+            {
+                sinteger_t n1 = r[i->b], n2 = r[i->c];
+                if (n2 == 0 || (n2 == -1 && !i->uns))
+                    return false;   // errors and overflow checks
+                sinteger_t n;
+                if (i->uns)
+                    n = i->op == BCdiv ? (dinteger_t)n1 / (dinteger_t)n2 : (dinteger_t)n1 % (dinteger_t)n2;
+                else
+                    n = i->op == BCdiv ? n1 / n2 : n1 % n2;
+                r[i->a] = normalize(n, i->kind);
+                break;
+            }
+
+            case BCshl:
+            case BCshr:
+            case BCushr:
+            {
+                sinteger_t count = r[i->c];
+                if (count < 0 || count >= i->width)
+                    return false;
+                dinteger_t value = r[i->b];
+                if (i->op == BCshl)
+                    value <<= count;
+                else if (i->op == BCshr && !i->uns)
+                    value = (sinteger_t)value >> count;
+                else
+                {
+                    if (i->width < 64)
+                        value &= (1ULL << i->width) - 1;
+                    value >>= count;
+                }
+                r[i->a] = normalize(value, i->kind);
+                break;
+            }
+
+            case BClt:
+                r[i->a] = i->uns ? (dinteger_t)r[i->b] < (dinteger_t)r[i->c] : r[i->b] < r[i->c];
+                break;
+            case BCle:
+                r[i->a] = i->uns ? (dinteger_t)r[i->b] <= (dinteger_t)r[i->c] : r[i->b] <= r[i->c];
+                break;
+
+            case BCjmp:     pc = i->a;                      break;
+            case BCjz:      if (!r[i->b]) pc = i->a;        break;
+            case BCjnz:     if (r[i->b]) pc = i->a;         break;
+
+            case BCcall:
+            {
+                // The callee frame starts right after ours
+                BcFunction *callee = bf->callees[i->c];
+                size_t calleeBase = base + bf->nregs;
+                reserveStack(calleeBase + callee->nparams);
+                memcpy(bcStack + calleeBase, bcStack + base + i->b, callee->nparams * sizeof(sinteger_t));
+                sinteger_t value;
+                if (!bcExecute(callee, calleeBase, depth + 1, &value))
+                    return false;
+                bcStack[base + i->a] = value;
+                break;
+            }
+
+            case BCret:
+                *presult = normalize(r[i->a], bf->resultKind);
+                return true;
+
+            case BCfail:
+                return false;
+
+            default:
+                assert(0);
+        }
+    }
+}
+
+/*************************************
+ * Try to run a call to fd with the bytecode engine.
+ * Input:
+ *      arguments  interpreted function arguments
+ *
+ * Return the result of the call, or NULL if the tree interpreter
+ * must do it.
+ */
+Expression *ctfeBytecodeInterpret(FuncDeclaration *fd, Expressions *arguments)
+{
+    size_t dim = arguments ? arguments->dim : 0;
+    for (size_t i = 0; i < dim; i++)
+    {
+        if ((*arguments)[i]->op != TOKint64)
+            return NULL;
+    }
+
+    BcFunction *bf = bcCompile(fd);
+    if (!bf || !bf->ok)
+        return NULL;
+
+    reserveStack(bf->nregs);
+    for (size_t i = 0; i < dim; i++)
+    {
+        unsigned char kind;
+        toBcKind((*fd->parameters)[i]->type, &kind);
+        bcStack[i] = normalize((*arguments)[i]->toInteger(), kind);
+    }
+
+    sinteger_t value;
+    if (!bcExecute(bf, 0, CtfeStatus::callDepth + 1, &value))
+        return NULL;
+
+    TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+    return new IntegerExp(fd->loc, value, tf->next);
+}
@@ -16,6 +16,7 @@
 #include <new>
 
 #include "rmem.h"
+#include "aav.h"
 
 #include "expression.h"
 #include "declaration.h"
@@ -201,6 +202,246 @@ Expression *UnionExp::copy()
     return e->copy();
 }
 
+#if IN_LLVM
+/************** CtfeArena ********************************************/
+
+// Expressions are small, so the arena never needs bigger chunks
+#define CTFE_ARENA_CHUNK_SIZE (256 * 4096 - 64)
+
+CtfeArena *CtfeArena::current = NULL;
+size_t CtfeArena::memoryInUse = 0;
+size_t CtfeArena::peakMemory = 0;
+
+struct CtfeArenaChunk
+{
+    char *mem;
+    CtfeArena *arena;   // NULL once the arena is done but the chunk is kept
+};
+
+// All the chunks not freed yet, sorted by address
+static Array<CtfeArenaChunk> ctfeArenaChunks;
+
+static size_t findArenaChunk(void *p)
+{
+    // Index of the first chunk starting after p
+    size_t lo = 0, hi = ctfeArenaChunks.dim;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (ctfeArenaChunks[mid].mem <= (char *)p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+CtfeArena::CtfeArena()
+{
+    prev = current;
+    ptr = NULL;
+    left = 0;
+    current = this;
+}
+
+void *CtfeArena::alloc(size_t size)
+{
+    size = (size + 15) & ~15;
+    assert(size <= CTFE_ARENA_CHUNK_SIZE);
+    if (size > left)
+    {
+        CtfeArenaChunk chunk;
+        chunk.mem = (char *)mem.xmalloc(CTFE_ARENA_CHUNK_SIZE);
+        chunk.arena = this;
+        ctfeArenaChunks.insert(findArenaChunk(chunk.mem), chunk);
+
+        memoryInUse += CTFE_ARENA_CHUNK_SIZE;
+        if (memoryInUse > peakMemory)
+            peakMemory = memoryInUse;
+
+        ptr = chunk.mem;
+        left = CTFE_ARENA_CHUNK_SIZE;
+    }
+    void *p = ptr;
+    ptr += size;
+    left -= size;
+    return p;
+}
+
+bool CtfeArena::owns(void *p)
+{
+    size_t i = findArenaChunk(p);
+    return i > 0 && (char *)p < ctfeArenaChunks[i - 1].mem + CTFE_ARENA_CHUNK_SIZE;
+}
+
+/* Deep copy of the CTFE value e out of the arena.
+ * Return NULL if e contains something we don't know how to copy.
+ */
+static Expression *copyOutOfArena(Expression *e, AA **copies)
+{
+    if (!e)
+        return NULL;
+    if (e == CTFEExp::cantexp || e == CTFEExp::voidexp || e == CTFEExp::breakexp ||
+        e == CTFEExp::continueexp || e == CTFEExp::gotoexp)
+        return e;
+
+    // Preserve sharing and cycles (e.g. struct literals pointing to themselves)
+    Expression **pcopy = (Expression **)dmd_aaGet(copies, (void *)e);
+    if (*pcopy)
+        return *pcopy;
+
+    Expression *ex = e->copy();
+    *pcopy = ex;
+
+#define COPY(x) do { if (x && !(x = copyOutOfArena(x, copies))) return NULL; } while (0)
+
+    switch (e->op)
+    {
+        case TOKint64:
+        case TOKfloat64:
+        case TOKcomplex80:
+        case TOKnull:
+        case TOKstring:
+        case TOKvar:
+        case TOKsymoff:
+        case TOKfunction:
+        case TOKtype:
+        case TOKerror:
+        case TOKvoid:
+            break;
+
+        case TOKtypeid:
+            if (isExpression(((TypeidExp *)e)->obj))
+                return NULL;
+            break;
+
+        case TOKarrayliteral:
+        {
+            ArrayLiteralExp *ae = (ArrayLiteralExp *)ex;
+            if (ae->elements)
+            {
+                ae->elements = ae->elements->copy();
+                for (size_t i = 0; i < ae->elements->dim; i++)
+                    COPY((*ae->elements)[i]);
+            }
+            break;
+        }
+
+        case TOKassocarrayliteral:
+        {
+            AssocArrayLiteralExp *ae = (AssocArrayLiteralExp *)ex;
+            ae->keys = ae->keys->copy();
+            ae->values = ae->values->copy();
+            for (size_t i = 0; i < ae->keys->dim; i++)
+            {
+                COPY((*ae->keys)[i]);
+                COPY((*ae->values)[i]);
+            }
+            break;
+        }
+
+        case TOKstructliteral:
+        {
+            StructLiteralExp *se = (StructLiteralExp *)ex;
+            if (se->elements)
+            {
+                se->elements = se->elements->copy();
+                for (size_t i = 0; i < se->elements->dim; i++)
+                    COPY((*se->elements)[i]);
+            }
+            if (se->origin == (StructLiteralExp *)e)
+                se->origin = se;
+            else if (CtfeArena::owns(se->origin))
+            {
+                Expression **porigin = (Expression **)dmd_aaGet(copies, (void *)se->origin);
+                se->origin = *porigin ? (StructLiteralExp *)*porigin : se;
+            }
+            se->inlinecopy = NULL;
+            se->stageflags = 0;
+            break;
+        }
+
+        case TOKclassreference:
+        {
+            ClassReferenceExp *cre = (ClassReferenceExp *)ex;
+            Expression *value = cre->value;
+            COPY(value);
+            cre->value = (StructLiteralExp *)value;
+            break;
+        }
+
+        case TOKthrownexception:
+        {
+            ThrownExceptionExp *te = (ThrownExceptionExp *)ex;
+            Expression *thrown = te->thrown;
+            COPY(thrown);
+            te->thrown = (ClassReferenceExp *)thrown;
+            break;
+        }
+
+        case TOKaddress:
+        case TOKdotvar:
+        case TOKdelegate:
+        case TOKvector:
+        case TOKcast:
+        case TOKstar:
+            COPY(((UnaExp *)ex)->e1);
+            break;
+
+        case TOKindex:
+            COPY(((BinExp *)ex)->e1);
+            COPY(((BinExp *)ex)->e2);
+            break;
+
+        case TOKslice:
+            COPY(((SliceExp *)ex)->e1);
+            COPY(((SliceExp *)ex)->lwr);
+            COPY(((SliceExp *)ex)->upr);
+            break;
+
+        default:
+            return NULL;
+    }
+
+#undef COPY
+
+    return ex;
+}
+
+Expression *CtfeArena::finish(Expression *result)
+{
+    assert(current == this);
+    current = prev;
+
+    // Copies go to the enclosing arena, or to the heap
+    AA *copies = NULL;
+    Expression *copy = result ? copyOutOfArena(result, &copies) : NULL;
+
+    // If the result couldn't be copied, keep the memory it may refer to
+    bool release = copy || !result;
+
+    size_t j = 0;
+    for (size_t i = 0; i < ctfeArenaChunks.dim; i++)
+    {
+        CtfeArenaChunk chunk = ctfeArenaChunks[i];
+        if (chunk.arena == this)
+        {
+            if (release)
+            {
+                mem.xfree(chunk.mem);
+                memoryInUse -= CTFE_ARENA_CHUNK_SIZE;
+                continue;
+            }
+            chunk.arena = NULL;
+        }
+        ctfeArenaChunks[j++] = chunk;
+    }
+    ctfeArenaChunks.setDim(j);
+
+    return copy ? copy : result;
+}
+#endif
+
 /************** Aggregate literals (AA/string/array/struct) ******************/
 
 // Given expr, which evaluates to an array/AA/string literal,
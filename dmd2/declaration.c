@@ -1994,6 +1994,10 @@ Expression *VarDeclaration::getConstInitializer(bool needFullType)
             global.gag = 0;
     }
 
+#if IN_LLVM
+    // The analyzed initializer is kept, don't put it in a CTFE arena
+    CtfeArenaSuspend suspend;
+#endif
     if (scope)
     {
         inuse++;
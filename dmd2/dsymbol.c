@@ -42,6 +42,18 @@ const char* Pprotectionnames[] = {NULL, "none", "private", "package", "protected
 
 /****************************** Dsymbol ******************************/
 
+#if IN_LLVM
+void *Dsymbol::operator new(size_t size)
+{
+    return mem.xmalloc(size, MEMdsymbol);
+}
+
+void Dsymbol::operator delete(void *p)
+{
+    mem.xfree(p);
+}
+#endif
+
 Dsymbol::Dsymbol()
 {
     //printf("Dsymbol::Dsymbol(%p)\n", this);
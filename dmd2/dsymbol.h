@@ -173,6 +173,11 @@ public:
 
     Dsymbol();
     Dsymbol(Identifier *);
+#if IN_LLVM
+    // Accounted for by -memory-report
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+#endif
     static Dsymbol *create(Identifier *);
     char *toChars();
     virtual char *toPrettyCharsHelper(); // helper to print fully qualified (template) arguments
@@ -2035,6 +2035,26 @@ Expression *Expression::syntaxCopy()
     return copy();
 }
 
+#if IN_LLVM
+void *Expression::operator new(size_t size)
+{
+    if (CtfeArena::current)
+    {
+        memAccounts[MEMctfe].count++;
+        memAccounts[MEMctfe].bytes += size;
+        return CtfeArena::current->alloc(size);
+    }
+    return mem.xmalloc(size, MEMexpression);
+}
+
+void Expression::operator delete(void *p)
+{
+    // Arena memory is only released with the whole arena
+    if (!CtfeArena::owns(p))
+        mem.xfree(p);
+}
+#endif
+
 /*********************************
  * Does *not* do a deep copy.
  */
@@ -2051,7 +2071,11 @@ Expression *Expression::copy()
 #endif
         assert(0);
     }
+#if IN_LLVM
+    e = (Expression *)Expression::operator new(size);
+#else
     e = (Expression *)mem.xmalloc(size);
+#endif
     //printf("Expression::copy(op = %d) e = %p\n", op, e);
     return (Expression *)memcpy((void*)e, (void*)this, size);
 }
@@ -9677,16 +9701,17 @@ Expression *DeleteExp::semantic(Scope *sc)
         }
         case Tpointer:
             tb = ((TypePointer *)tb)->next->toBasetype();
-            if (tb->ty == Tstruct)
+            if (tb->ty == Tstruct ||
+                (tb->ty == Tclass && !((TypeClass *)tb)->sym->byRef())) // CALYPSO C++ class values may have a deallocator too
             {
-                TypeStruct *ts = (TypeStruct *)tb;
-                StructDeclaration *sd = ts->sym;
-                FuncDeclaration *f = sd->aggDelete;
-                FuncDeclaration *fd = sd->dtor;
+                AggregateDeclaration *ad = isAggregate(tb);
+                FuncDeclaration *f = ad->aggDelete;
+                FuncDeclaration *fd = ad->dtor;
 
                 if (!f)
                 {
-                    semanticTypeInfo(sc, ts);
+                    if (tb->ty == Tstruct)
+                        semanticTypeInfo(sc, tb);
                     break;
                 }
 
@@ -145,6 +145,12 @@ public:
     unsigned char parens;       // if this is a parenthesized expression
 
     Expression(Loc loc, TOK op, int size);
+#if IN_LLVM
+    // Allocated from the current CTFE arena, if any
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, void *p) { return p; }
+    static void operator delete(void *p);
+#endif
     static void init();
     Expression *copy();
     virtual Expression *syntaxCopy();
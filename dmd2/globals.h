@@ -128,6 +128,9 @@ struct Param
     bool addMain; // LDC_FIXME: Implement.
     bool allInst; // LDC_FIXME: Implement.
     unsigned nestedTmpl; // maximum nested template instantiations
+    bool ctfeBytecode;  // run CTFE with the bytecode engine when possible
+    bool ctfeMemoize;   // reuse the results of strongly pure CTFE calls
+    bool ctfeReleaseMemory; // free CTFE temporaries after each top-level evaluation
 #else
     bool pic;           // generate position-independent-code for shared libs
     bool color;         // use ANSI colors in console output
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <assert.h>
 
+#include "rmem.h"
 #include "mars.h"
 #include "init.h"
 #include "expression.h"
@@ -28,6 +29,18 @@
 
 /********************************** Initializer *******************************/
 
+#if IN_LLVM
+void *Initializer::operator new(size_t size)
+{
+    return mem.xmalloc(size, MEMinitializer);
+}
+
+void Initializer::operator delete(void *p)
+{
+    mem.xfree(p);
+}
+#endif
+
 Initializer::Initializer(Loc loc)
 {
     this->loc = loc;
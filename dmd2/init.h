@@ -37,6 +37,11 @@ public:
     Loc loc;
 
     Initializer(Loc loc);
+#if IN_LLVM
+    // Accounted for by -memory-report
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+#endif
     virtual Initializer *syntaxCopy() = 0;
     static Initializers *arraySyntaxCopy(Initializers *ai);
 
@@ -33,6 +33,10 @@
 #include "template.h"
 #include "port.h"
 #include "ctfe.h"
+#include "stringtable.h"
+#if IN_LLVM
+#include "gen/timetrace.h"
+#endif
 
 /* Interpreter: what form of return value expression is required?
  */
@@ -52,9 +56,6 @@ Expression *interpret(Expression *e, InterState *istate, CtfeGoal goal = ctfeNee
 #define LOGCOMPILE 0
 #define SHOWPERFORMANCE 0
 
-// Maximum allowable recursive function calls in CTFE
-#define CTFE_RECURSION_LIMIT 1000
-
 /**
   The values of all CTFE variables
 */
@@ -257,6 +258,9 @@ int CtfeStatus::stackTraceCallsToSuppress = 0;
 int CtfeStatus::maxCallDepth = 0;
 int CtfeStatus::numArrayAllocs = 0;
 int CtfeStatus::numAssignments = 0;
+#if IN_LLVM
+int CtfeStatus::numMemoizedCalls = 0;
+#endif
 
 // CTFE diagnostic information
 void printCtfePerformanceStats()
@@ -264,7 +268,12 @@ void printCtfePerformanceStats()
 #if SHOWPERFORMANCE
     printf("        ---- CTFE Performance ----\n");
     printf("max call depth = %d\tmax stack = %d\n", CtfeStatus::maxCallDepth, ctfeStack.maxStackUsage());
-    printf("array allocs = %d\tassignments = %d\n\n", CtfeStatus::numArrayAllocs, CtfeStatus::numAssignments);
+    printf("array allocs = %d\tassignments = %d\n", CtfeStatus::numArrayAllocs, CtfeStatus::numAssignments);
+#if IN_LLVM
+    printf("memoized calls = %d\n", CtfeStatus::numMemoizedCalls);
+    printf("peak memory = %llu KB\n", (ulonglong)(CtfeArena::peakMemory / 1024));
+#endif
+    printf("\n");
 #endif
 }
 
@@ -743,9 +752,22 @@ Expression *ctfeInterpret(Expression *e)
     ctfeCodeGlobal.callingloc = e->loc;
     ctfeCodeGlobal.onExpression(e);
 
+#if IN_LLVM
+    TimeTraceScope timeScope("CTFE", [e] { return e->toChars(); });
+    // With -ctfe-release-memory, temporaries go to an arena and only the
+    // result is kept. Otherwise they are allocated on the heap as usual.
+    CtfeArena *arena = global.params.ctfeReleaseMemory ? new CtfeArena() : NULL;
+#endif
     Expression *result = interpret(e, NULL);
     if (!CTFEExp::isCantExp(result))
         result = scrubReturnValue(e->loc, result);
+#if IN_LLVM
+    if (arena)
+    {
+        result = arena->finish(result);
+        delete arena;
+    }
+#endif
     if (CTFEExp::isCantExp(result))
     {
         assert(global.errors != olderrors);
@@ -804,6 +826,133 @@ Expression *ctfeInterpretForPragmaMsg(Expression *e)
     return e;
 }
 
+#if IN_LLVM
+/*************************************
+ * Memoization of strongly pure function calls.
+ *
+ * Strongly pure functions always return the same value for the same
+ * arguments, so results are kept for the whole compilation, keyed by
+ * the function and the serialized argument values.
+ */
+
+static StringTable ctfeMemoTable;
+static bool ctfeMemoTableInit = false;
+
+/* Serialize a CTFE value made only of literals.
+ * Return false if e isn't one (references, pointers, class objects...).
+ */
+static bool serializeCtfeValue(OutBuffer *buf, Expression *e)
+{
+    if (!e)
+    {
+        buf->writeByte('_');
+        return true;
+    }
+    switch (e->op)
+    {
+        case TOKint64:
+            buf->printf("i%llx;", (ulonglong)e->toInteger());
+            return true;
+
+        case TOKfloat64:
+            buf->printf("r%La;", (long double)e->toReal());
+            return true;
+
+        case TOKcomplex80:
+        {
+            complex_t c = e->toComplex();
+            buf->printf("c%La,%La;", (long double)creall(c), (long double)cimagl(c));
+            return true;
+        }
+
+        case TOKnull:
+            buf->writestring("n;");
+            return true;
+
+        case TOKstring:
+        {
+            StringExp *se = (StringExp *)e;
+            buf->printf("s%u:%llu:", (unsigned)se->sz, (ulonglong)se->len);
+            buf->write(se->string, se->len * se->sz);
+            return true;
+        }
+
+        case TOKarrayliteral:
+        {
+            Expressions *elements = ((ArrayLiteralExp *)e)->elements;
+            size_t dim = elements ? elements->dim : 0;
+            buf->printf("a%llu[", (ulonglong)dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                if (!serializeCtfeValue(buf, (*elements)[i]))
+                    return false;
+            }
+            buf->writeByte(']');
+            return true;
+        }
+
+        case TOKassocarrayliteral:
+        {
+            AssocArrayLiteralExp *ae = (AssocArrayLiteralExp *)e;
+            buf->printf("A%llu[", (ulonglong)ae->keys->dim);
+            for (size_t i = 0; i < ae->keys->dim; i++)
+            {
+                if (!serializeCtfeValue(buf, (*ae->keys)[i]) ||
+                    !serializeCtfeValue(buf, (*ae->values)[i]))
+                    return false;
+            }
+            buf->writeByte(']');
+            return true;
+        }
+
+        case TOKstructliteral:
+        {
+            StructLiteralExp *se = (StructLiteralExp *)e;
+            size_t dim = se->elements ? se->elements->dim : 0;
+            buf->printf("S%p[", se->sd);
+            for (size_t i = 0; i < dim; i++)
+            {
+                if (!serializeCtfeValue(buf, (*se->elements)[i]))
+                    return false;
+            }
+            buf->writeByte(']');
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/* Return the memoization key of a call to fd, or NULL if the call
+ * can't be memoized.
+ */
+static StringValue *ctfeMemoEntry(FuncDeclaration *fd, Expressions *eargs, Expression *thisarg)
+{
+    if (!global.params.ctfeMemoize || thisarg || fd->isNested())
+        return NULL;
+    TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+    if (tf->isref || tf->varargs || fd->isPure() != PUREstrong)
+        return NULL;
+
+    OutBuffer buf;
+    buf.printf("%p(", fd);
+    for (size_t i = 0; i < eargs->dim; i++)
+    {
+        if (!serializeCtfeValue(&buf, (*eargs)[i]))
+            return NULL;
+    }
+    buf.writeByte(')');
+
+    if (!ctfeMemoTableInit)
+    {
+        ctfeMemoTable._init();
+        ctfeMemoTableInit = true;
+    }
+    return ctfeMemoTable.update((char *)buf.data, buf.offset);
+}
+#endif
+
 /*************************************
  * Attempt to interpret a function given the arguments.
  * Input:
@@ -819,14 +968,22 @@ Expression *interpret(FuncDeclaration *fd, InterState *istate, Expressions *argu
 {
 #if LOG
     printf("\n********\n%s FuncDeclaration::interpret(istate = %p) %s\n", fd->loc.toChars(), istate, fd->toChars());
+#endif
+#if IN_LLVM
+    TimeTraceScope timeScope("CTFE call", [fd] { return fd->toPrettyChars(); });
 #endif
     if (fd->semanticRun == PASSsemantic3)
     {
         fd->error("circular dependency. Functions cannot be interpreted while being compiled");
         return CTFEExp::cantexp;
     }
-    if (!fd->functionSemantic3())
-        return CTFEExp::cantexp;
+    {
+#if IN_LLVM
+        CtfeArenaSuspend suspend;
+#endif
+        if (!fd->functionSemantic3())
+            return CTFEExp::cantexp;
+    }
     if (fd->semanticRun < PASSsemantic3done)
         return CTFEExp::cantexp;
 
@@ -921,6 +1078,22 @@ Expression *interpret(FuncDeclaration *fd, InterState *istate, Expressions *argu
         eargs[i] = earg;
     }
 
+#if IN_LLVM
+    StringValue *memo = ctfeMemoEntry(fd, &eargs, thisarg);
+    if (memo && memo->ptrvalue)
+    {
+        ++CtfeStatus::numMemoizedCalls;
+        return copyLiteral((Expression *)memo->ptrvalue).copy();
+    }
+
+    // Calls the bytecode engine can handle never need a frame
+    if (global.params.ctfeBytecode && !thisarg)
+    {
+        if (Expression *e = ctfeBytecodeInterpret(fd, &eargs))
+            return e;
+    }
+#endif
+
     // Now that we've evaluated all the arguments, we can start the frame
     // (this is the moment when the 'call' actually takes place).
     InterState istatex;
@@ -1055,6 +1228,18 @@ Expression *interpret(FuncDeclaration *fd, InterState *istate, Expressions *argu
         e = CTFEExp::cantexp;
     }
 
+#if IN_LLVM
+    if (memo)
+    {
+        // The caller may modify the result in place, keep a copy
+        // outliving the CTFE arena
+        OutBuffer buf;
+        CtfeArenaSuspend suspend;
+        if (serializeCtfeValue(&buf, e))
+            memo->ptrvalue = copyLiteral(e).copy();
+    }
+#endif
+
     return e;
 }
 
@@ -2262,6 +2447,9 @@ public:
 
             if (!v->originalType && v->scope)   // semantic() not yet run
             {
+#if IN_LLVM
+                CtfeArenaSuspend suspend;
+#endif
                 v->semantic (v->scope);
                 if (v->type->ty == Terror)
                     return CTFEExp::cantexp;
@@ -2276,6 +2464,11 @@ public:
                     error(loc, "circular initialization of %s", v->toChars());
                     return CTFEExp::cantexp;
                 }
+#if IN_LLVM
+                // The initializer and the cached value of globals outlive
+                // the CTFE arena
+                CtfeArenaSuspend suspend;
+#endif
                 if (v->scope)
                 {
                     v->inuse++;
@@ -2370,10 +2563,15 @@ public:
         else if (SymbolDeclaration *s = d->isSymbolDeclaration())
         {
             // Struct static initializers, for example
-            e = s->dsym->type->defaultInitLiteral(loc);
-            if (e->op == TOKerror)
-                error(loc, "CTFE failed because of previous errors in %s.init", s->toChars());
-            e = e->semantic(NULL);
+            {
+#if IN_LLVM
+                CtfeArenaSuspend suspend;
+#endif
+                e = s->dsym->type->defaultInitLiteral(loc);
+                if (e->op == TOKerror)
+                    error(loc, "CTFE failed because of previous errors in %s.init", s->toChars());
+                e = e->semantic(NULL);
+            }
             if (e->op == TOKerror)
                 e = CTFEExp::cantexp;
             else // Convert NULL to CTFEExp
@@ -3668,6 +3866,19 @@ public:
                 }
                 oldval = resolveSlice(oldval);
 
+#if IN_LLVM
+                /* e.g. a /= b with a ubyte and b an int is typed as
+                 * cast(int)a /= b. Like codegen, compute in the promoted type
+                 * so that the division is signed, except for shifts which use
+                 * the type of the variable.
+                 */
+                if (e->e1->op == TOKcast && oldval->op == TOKint64 &&
+                    e->e1->type->isintegral() && e->op != TOKshlass &&
+                    e->op != TOKshrass && e->op != TOKushrass)
+                {
+                    oldval = new IntegerExp(e->loc, oldval->toInteger(), e->e1->type);
+                }
+#endif
                 newval = (*fp)(e->type, oldval, newval).copy();
             }
             else if (e->e2->type->isintegral() &&
@@ -4887,7 +5098,10 @@ public:
         {
             auto lp = fd->langPlugin();
             if (lp && lp->canInterpret(fd))
+            {
+                CtfeArenaSuspend suspend; // the language plugin may cache what it creates
                 result = lp->interpret(fd, istate, e->arguments, pthis);  // CALYPSO
+            }
             else
             {
                 e->error("%s cannot be interpreted at compile time,"
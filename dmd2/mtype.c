@@ -48,6 +48,9 @@
 #include "import.h"
 #include "aggregate.h"
 #include "hdrgen.h"
+#if IN_LLVM
+#include "ctfe.h"
+#endif
 
 #define LOGDOTEXP       0       // log ::dotExp()
 #define LOGDEFAULTINIT  0       // log ::defaultInit()
@@ -131,6 +134,18 @@ void initTypeMangle();
 void mangleToBuffer(Type *t, OutBuffer *buf, bool forEquiv = false);
 void mangleToBufferInternal(Type *t, OutBuffer *buf, bool internal);
 
+#if IN_LLVM
+void *Type::operator new(size_t size)
+{
+    return mem.xmalloc(size, MEMtype);
+}
+
+void Type::operator delete(void *p)
+{
+    mem.xfree(p);
+}
+#endif
+
 Type::Type(TY ty)
 {
     this->ty = ty;
@@ -165,7 +180,11 @@ unsigned short Type::sizeType()
 
 Type *Type::copy()
 {
+#if IN_LLVM
+    Type *t = (Type *)mem.xmalloc(sizeType(), MEMtype);
+#else
     Type *t = (Type *)mem.xmalloc(sizeType());
+#endif
     memcpy((void*)t, (void*)this, sizeType());
     return t;
 }
@@ -1250,6 +1269,10 @@ Type *Type::arrayOf()
 Type *Type::sarrayOf(dinteger_t dim)
 {
     assert(deco);
+#if IN_LLVM
+    // Merged types live in the type table, not in a CTFE arena
+    CtfeArenaSuspend suspend;
+#endif
     Type *t = new TypeSArray(this, new IntegerExp(Loc(), dim, Type::tsize_t));
 
     // according to TypeSArray::semantic()
@@ -232,6 +232,11 @@ public:
     static unsigned char impcnvWarn[TMAX][TMAX];
 
     Type(TY ty);
+#if IN_LLVM
+    // Accounted for by -memory-report
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+#endif
     virtual const char *kind();
     Type *copy();
     virtual Type *syntaxCopy(Type *o = NULL); // CALYPSO
@@ -18,6 +18,18 @@
 
 Mem mem;
 
+#if IN_LLVM
+MemAccount memAccounts[MEMmax];
+
+size_t memAccountedBytes()
+{
+    size_t bytes = 0;
+    for (int i = 0; i < MEMmax; i++)
+        bytes += memAccounts[i].bytes;
+    return bytes;
+}
+#endif
+
 char *Mem::xstrdup(const char *s)
 {
     char *p;
@@ -12,12 +12,44 @@
 
 #include <stddef.h>     // for size_t
 
+#if IN_LLVM
+/* Kinds of objects whose allocations are accounted for (-memory-report)
+ */
+enum MemKind
+{
+    MEMdsymbol,
+    MEMtype,
+    MEMexpression,
+    MEMstatement,
+    MEMinitializer,
+    MEMctfe,            // Expressions allocated in a CTFE arena
+    MEMmax
+};
+
+struct MemAccount
+{
+    size_t count;       // number of allocations
+    size_t bytes;       // total size of the allocations, frees aren't deducted
+};
+
+extern MemAccount memAccounts[MEMmax];
+size_t memAccountedBytes();
+#endif
+
 struct Mem
 {
     Mem() { }
 
     char *xstrdup(const char *s);
     void *xmalloc(size_t size);
+#if IN_LLVM
+    void *xmalloc(size_t size, MemKind kind)
+    {
+        memAccounts[kind].count++;
+        memAccounts[kind].bytes += size;
+        return xmalloc(size);
+    }
+#endif
     void *xcalloc(size_t size, size_t n);
     void *xrealloc(void *p, size_t size);
     void xfree(void *p);
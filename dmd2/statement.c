@@ -66,6 +66,18 @@ LabelStatement *checkLabeledLoop(Scope *sc, Statement *statement)
 
 /******************************** Statement ***************************/
 
+#if IN_LLVM
+void *Statement::operator new(size_t size)
+{
+    return mem.xmalloc(size, MEMstatement);
+}
+
+void Statement::operator delete(void *p)
+{
+    mem.xfree(p);
+}
+#endif
+
 Statement::Statement(Loc loc)
     : loc(loc)
 {
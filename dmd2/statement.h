@@ -103,6 +103,11 @@ public:
     virtual ~Statement() {}
 
     Statement(Loc loc);
+#if IN_LLVM
+    // Accounted for by -memory-report
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+#endif
     virtual Statement *syntaxCopy();
 
     void print();
@@ -41,6 +41,7 @@
 
 #if IN_LLVM
 #include "gen/pragma.h"
+#include "gen/timetrace.h"
 void DtoOverloadedIntrinsicName(TemplateInstance* ti, TemplateDeclaration* td, std::string& name);
 #endif
 
@@ -372,6 +373,30 @@ int arrayObjectMatch(Objects *oa1, Objects *oa2)
 }
 
 
+#if IN_LLVM
+/************************************
+ * Combine the hash h with the value v, depending on the order of the values.
+ */
+static inline hash_t mixHash(hash_t h, hash_t v)
+{
+    return h ^ (v + (hash_t)0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2));
+}
+
+/************************************
+ * Spread the bits of h, so that its low bits can index a table.
+ */
+static inline hash_t finalizeHash(hash_t h)
+{
+    unsigned long long x = h;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return (hash_t)x;
+}
+#endif
+
 /************************************
  * Return hash of Objects.
  */
@@ -383,8 +408,15 @@ hash_t arrayObjectHash(Objects *oa1)
         /* Must follow the logic of match()
          */
         RootObject *o1 = (*oa1)[j];
+#if IN_LLVM
+        hash_t h = 0;
+#endif
         if (Type *t1 = isType(o1))
+#if IN_LLVM
+            h = (size_t)t1->deco;
+#else
             hash += (size_t)t1->deco;
+#endif
         else
         {
             Dsymbol *s1 = isDsymbol(o1);
@@ -394,7 +426,11 @@ hash_t arrayObjectHash(Objects *oa1)
                 if (e1->op == TOKint64)
                 {
                     IntegerExp *ne = (IntegerExp *)e1;
+#if IN_LLVM
+                    h = finalizeHash((size_t)ne->getInteger());
+#else
                     hash += (size_t)ne->getInteger();
+#endif
                 }
             }
             else if (s1)
@@ -402,11 +438,23 @@ hash_t arrayObjectHash(Objects *oa1)
                 FuncAliasDeclaration *fa1 = s1->isFuncAliasDeclaration();
                 if (fa1)
                     s1 = fa1->toAliasFunc();
+#if IN_LLVM
+                h = mixHash((size_t)(void *)s1->getIdent(), (size_t)(void *)s1->parent);
+#else
                 hash += (size_t)(void *)s1->getIdent() + (size_t)(void *)s1->parent;
+#endif
             }
             else if (Tuple *u1 = isTuple(o1))
+#if IN_LLVM
+                h = arrayObjectHash(&u1->objects);
+#else
                 hash += arrayObjectHash(&u1->objects);
+#endif
         }
+#if IN_LLVM
+        // Mix in the position too, so that Foo!(1, 2) and Foo!(2, 1) differ
+        hash = mixHash(hash, h);
+#endif
     }
     return hash;
 }
@@ -460,7 +508,9 @@ TemplateDeclaration::TemplateDeclaration(Loc loc, Identifier *id,
     this->isstatic = true;
     this->previous = NULL;
     this->protection = Prot(PROTundefined);
+#if !IN_LLVM
     this->numinstances = 0;
+#endif
 
     // Compute in advance for Ddoc's use
     // Bugzilla 11153: ident could be NULL if parsing fails.
@@ -2868,6 +2918,9 @@ TemplateInstance *TemplateDeclaration::findExistingInstance(TemplateInstance *ti
     tithis->fargs = fargs;
     hash_t hash = tithis->hashCode();
 
+#if IN_LLVM
+    return instances.find(tithis, hash);
+#else
     if (!buckets.dim)
     {
         buckets.setDim(7);
@@ -2893,6 +2946,7 @@ TemplateInstance *TemplateDeclaration::findExistingInstance(TemplateInstance *ti
     }
     //printf("hash = %p no\n", hash);
     return NULL;        // didn't find a match
+#endif
 }
 
 /********************************************
@@ -2902,6 +2956,11 @@ TemplateInstance *TemplateDeclaration::findExistingInstance(TemplateInstance *ti
 
 TemplateInstance *TemplateDeclaration::addInstance(TemplateInstance *ti)
 {
+#if IN_LLVM
+    TemplateInstance::numInstances++;
+    instances.insert(ti);
+    return ti;
+#else
     /* See if we need to rehash
      */
     if (numinstances > buckets.dim * 4)
@@ -2941,6 +3000,7 @@ TemplateInstance *TemplateDeclaration::addInstance(TemplateInstance *ti)
     instances->push(ti);
     ++numinstances;
     return ti;
+#endif
 }
 
 /*******************************************
@@ -2951,6 +3011,9 @@ TemplateInstance *TemplateDeclaration::addInstance(TemplateInstance *ti)
 
 void TemplateDeclaration::removeInstance(TemplateInstance *handle)
 {
+#if IN_LLVM
+    instances.remove(handle);
+#else
     size_t bi = handle->hash % buckets.dim;
     TemplateInstances *instances = buckets[bi];
     for (size_t i = 0; i < instances->dim; i++)
@@ -2963,8 +3026,119 @@ void TemplateDeclaration::removeInstance(TemplateInstance *handle)
         }
     }
     --numinstances;
+#endif
+}
+
+#if IN_LLVM
+unsigned long long TemplateInstanceTable::numLookups = 0;
+unsigned long long TemplateInstanceTable::numProbes = 0;
+unsigned long long TemplateInstanceTable::numCollisions = 0;
+
+// Marks a slot whose instance was removed, probing goes on past it
+#define TI_TOMBSTONE ((TemplateInstance *)(size_t)1)
+
+TemplateInstance *TemplateInstanceTable::find(TemplateInstance *tithis, hash_t hash)
+{
+    numLookups++;
+    if (!dim)
+        return NULL;
+
+    // The table is never full, so an empty slot ends the probing
+    size_t mask = dim - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        numProbes++;
+        TemplateInstance *ti = slots[i];
+        if (!ti)
+            return NULL;
+        if (ti == TI_TOMBSTONE || ti->hash != hash)
+            continue;
+#if LOG
+        printf("\t%s: checking for match with instance %d (%p): '%s'\n", tithis->toChars(), i, ti, ti->toChars());
+#endif
+        if (tithis->compare(ti) == 0)
+            return ti;
+        numCollisions++;
+    }
 }
 
+void TemplateInstanceTable::insert(TemplateInstance *ti)
+{
+    // Keep the load factor, removed slots included, at most 1/2
+    if ((count + tombstones + 1) * 2 > dim)
+        rehash();
+
+    size_t mask = dim - 1;
+    size_t i = ti->hash & mask;
+    while (slots[i] && slots[i] != TI_TOMBSTONE)
+        i = (i + 1) & mask;
+    if (slots[i] == TI_TOMBSTONE)
+        tombstones--;
+    slots[i] = ti;
+    count++;
+}
+
+void TemplateInstanceTable::remove(TemplateInstance *ti)
+{
+    size_t i = slotOf(ti);
+    if (i == dim)
+        return;
+    slots[i] = TI_TOMBSTONE;
+    count--;
+    tombstones++;
+}
+
+/*******************************************
+ * Put with in the slot of ti, they must have the same hash.
+ */
+void TemplateInstanceTable::replace(TemplateInstance *ti, TemplateInstance *with)
+{
+    assert(ti->hash == with->hash);
+    size_t i = slotOf(ti);
+    if (i != dim)
+        slots[i] = with;
+}
+
+/*******************************************
+ * Return the slot holding ti, or dim if ti isn't in the table
+ * (e.g. its hash was reset since).
+ */
+size_t TemplateInstanceTable::slotOf(TemplateInstance *ti)
+{
+    if (!dim)
+        return 0;
+    size_t mask = dim - 1;
+    for (size_t i = ti->hash & mask; slots[i]; i = (i + 1) & mask)
+    {
+        if (slots[i] == ti)
+            return i;
+    }
+    return dim;
+}
+
+void TemplateInstanceTable::rehash()
+{
+    size_t newdim = 8;
+    while ((count + 1) * 4 > newdim)
+        newdim *= 2;
+
+    TemplateInstance **oldslots = slots;
+    size_t olddim = dim;
+    slots = (TemplateInstance **)mem.xcalloc(newdim, sizeof(TemplateInstance *));
+    dim = newdim;
+    count = 0;
+    tombstones = 0;
+    for (size_t i = 0; i < olddim; i++)
+    {
+        if (oldslots[i] && oldslots[i] != TI_TOMBSTONE)
+            insert(oldslots[i]);
+    }
+    mem.xfree(oldslots);
+}
+
+#undef TI_TOMBSTONE
+#endif
+
 /* ======================== Type ============================================ */
 
 /****
@@ -6086,9 +6260,41 @@ void TemplateInstance::trySemantic3(Scope *sc2)
     --nest;
 }
 
+#if IN_LLVM
+size_t TemplateInstance::numInstances = 0;
+size_t TemplateInstance::instantiationMemory = 0;
+
+/* Adds the frontend memory allocated by an outermost instantiation to
+ * TemplateInstance::instantiationMemory.
+ */
+struct InstantiationMemory
+{
+    static unsigned depth;
+    size_t start;
+
+    InstantiationMemory()
+    {
+        if (depth++ == 0)
+            start = memAccountedBytes();
+    }
+
+    ~InstantiationMemory()
+    {
+        if (--depth == 0)
+            TemplateInstance::instantiationMemory += memAccountedBytes() - start;
+    }
+};
+
+unsigned InstantiationMemory::depth = 0;
+#endif
+
 void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
 {
     //printf("[%s] TemplateInstance::semantic('%s', this=%p, gag = %d, sc = %p)\n", loc.toChars(), toChars(), this, global.gag, sc);
+#if IN_LLVM
+    TimeTraceScope timeScope("Instantiate", [this] { return toChars(); });
+    InstantiationMemory instantiationMemory;
+#endif
 #if 0
     for (Dsymbol *s = this; s; s = s->parent)
     {
@@ -6598,6 +6804,9 @@ Lerror:
          * On such case, the cached error instance needs to be overridden by the
          * succeeded instance.
          */
+#if IN_LLVM
+        tempdecl->instances.replace(errinst, this);
+#else
         size_t bi = hash % tempdecl->buckets.dim;
         TemplateInstances *instances = tempdecl->buckets[bi];
         assert(instances);
@@ -6610,6 +6819,7 @@ Lerror:
                 break;
             }
         }
+#endif
     }
 
 #if LOG
@@ -8168,8 +8378,12 @@ hash_t TemplateInstance::hashCode()
 {
     if (!hash)
     {
+#if IN_LLVM
+        hash = finalizeHash(mixHash((size_t)(void *)enclosing, arrayObjectHash(&tdtypes)));
+#else
         hash = (size_t)(void *)enclosing;
         hash += arrayObjectHash(&tdtypes);
+#endif
     }
     return hash;
 }
@@ -62,6 +62,35 @@ struct TemplatePrevious
     Objects *dedargs;
 };
 
+#if IN_LLVM
+/**
+  Open addressing hash table of the TemplateInstance's of a
+  TemplateDeclaration, probed linearly.
+ */
+struct TemplateInstanceTable
+{
+    TemplateInstance **slots;   // dim is a power of 2, NULL means empty
+    size_t dim;
+    size_t count;               // number of instances in the table
+    size_t tombstones;          // number of removed slots
+
+    // Statistics over all the tables, printed with -v
+    static unsigned long long numLookups;
+    static unsigned long long numProbes;
+    static unsigned long long numCollisions; // same hash, different arguments
+
+    TemplateInstanceTable() : slots(NULL), dim(0), count(0), tombstones(0) { }
+    TemplateInstance *find(TemplateInstance *tithis, hash_t hash);
+    void insert(TemplateInstance *ti);
+    void remove(TemplateInstance *ti);
+    void replace(TemplateInstance *ti, TemplateInstance *with);
+
+private:
+    size_t slotOf(TemplateInstance *ti);
+    void rehash();
+};
+#endif
+
 class TemplateDeclaration : public ScopeDsymbol
 {
 public:
@@ -71,8 +100,12 @@ public:
     Expression *constraint;
 
     // Hash table to look up TemplateInstance's of this TemplateDeclaration
+#if IN_LLVM
+    TemplateInstanceTable instances;
+#else
     Array<TemplateInstances *> buckets;
     size_t numinstances;                // number of instances in the hash table
+#endif
 
     TemplateDeclaration *overnext;      // next overloaded TemplateDeclaration
     TemplateDeclaration *overroot;      // first in overnext list
@@ -343,6 +376,11 @@ public:
     TemplateInstance *tnext;            // non-first instantiated instances
     Module *minst;                      // the top module that instantiated this instance
 
+#if IN_LLVM
+    static size_t numInstances;         // number of instances added to the tables
+    static size_t instantiationMemory;  // frontend memory allocated by the outermost instantiations
+#endif
+
     TemplateInstance(Loc loc, Identifier *temp_id);
     TemplateInstance(Loc loc, TemplateDeclaration *tempdecl, Objects *tiargs);
     static Objects *arraySyntaxCopy(Objects *objs);
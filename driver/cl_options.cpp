@@ -376,22 +376,97 @@ cl::opt<bool> linkonceTemplates(
         "Use linkonce_odr linkage for template symbols instead of weak_odr"),
     cl::ZeroOrMore);
 
+cl::opt<bool> externalArchiver(
+    "external-archiver",
+    cl::desc("Create static libraries by invoking the system archiver instead "
+             "of writing them in-process"),
+    cl::init(false));
+
+cl::opt<bool> inMemoryObjects(
+    "lib-in-memory",
+    cl::desc("With -lib, keep the object files in memory and only write the "
+             "static library (requires the internal archiver)"),
+    cl::init(false));
+
 cl::opt<bool> disableLinkerStripDead(
     "disable-linker-strip-dead",
     cl::desc("Do not try to remove unused symbols during linking"),
     cl::init(false));
 
+cl::opt<std::string>
+    ir2objCacheDir("cache",
+                   cl::desc("Enable the object file cache, using <dir> to store "
+                            "the cached object files"),
+                   cl::value_desc("dir"));
+
+cl::opt<bool> timeTrace(
+    "ftime-trace",
+    cl::desc("Write a trace of the time spent in each compilation phase, "
+             "viewable with chrome://tracing"),
+    cl::init(false));
+
+cl::opt<std::string>
+    timeTraceFile("ftime-trace-file",
+                  cl::desc("Write the -ftime-trace output to <filename> "
+                           "(default: <first object file>.time-trace.json)"),
+                  cl::value_desc("filename"));
+
+cl::opt<unsigned> timeTraceGranularity(
+    "ftime-trace-granularity",
+    cl::desc("Minimum time in microseconds of the spans recorded by "
+             "-ftime-trace"),
+    cl::value_desc("us"), cl::init(500));
+
+cl::opt<unsigned> semantic3Jobs(
+    "semantic3-jobs",
+    cl::desc("(experimental) Analyze the function bodies and generate the "
+             "code of the root modules in <n> worker processes (0: one per "
+             "CPU)"),
+    cl::value_desc("n"), cl::init(1));
+
+cl::opt<bool> memoryReport(
+    "memory-report",
+    cl::desc("Print the peak memory, the heap growth of each phase and the "
+             "memory used by each category of AST nodes (Dsymbol, Type, "
+             "Expression, ...), CTFE, template instances and Clang"),
+    cl::init(false));
+
+cl::opt<std::string> memoryReportFile(
+    "memory-report-file",
+    cl::desc("Write the memory report as JSON to <filename>"),
+    cl::value_desc("filename"));
+
 cl::opt<bool, true>
     allinst("allinst",
             cl::desc("generate code for all template instantiations"),
             cl::location(global.params.allInst));
 
+std::vector<const char *> allArguments;
+
 cl::opt<unsigned, true> nestedTemplateDepth(
     "template-depth",
     cl::desc(
         "(experimental) set maximum number of nested template instantiations"),
     cl::location(global.params.nestedTmpl), cl::init(500));
 
+cl::opt<bool, true> ctfeBytecode(
+    "ctfe-bytecode",
+    cl::desc("(experimental) Compile functions working on integral values to "
+             "bytecode for CTFE"),
+    cl::location(global.params.ctfeBytecode), cl::init(false));
+
+cl::opt<bool, true> ctfeMemoize(
+    "ctfe-memoize",
+    cl::desc("Evaluate strongly pure functions only once per set of arguments "
+             "during CTFE"),
+    cl::location(global.params.ctfeMemoize), cl::init(true));
+
+cl::opt<bool, true> ctfeReleaseMemory(
+    "ctfe-release-memory",
+    cl::desc("(experimental) Free the memory used by CTFE temporaries after "
+             "each top-level evaluation"),
+    cl::location(global.params.ctfeReleaseMemory), cl::init(false));
+
 #if LDC_LLVM_VER < 307
 cl::opt<bool, true, FlagParser<bool>>
     color("color", cl::desc("Force colored console output"),
@@ -426,6 +501,17 @@ cl::opt<std::string> cppCacheDir("cpp-cachedir",
 cl::opt<bool> cppVerboseDiags("cpp-verbosediags",
     cl::desc("Keep Clang diagnostics enabled after the PCH generation. For the time being those are mostly spurious errors from failed instantiations that can be ignored."));
 
+cl::opt<std::string> cppServer("cpp-server",
+    cl::desc("Keep the C++ AST loaded and serve the compilations of ldc2 processes started with LDC_CPP_SERVER=<path>"),
+    cl::value_desc("path"));
+
+cl::opt<bool> cppModules("cpp-modules",
+    cl::desc("Compile each Clang module described by a .modulemap_d file to its own module file, shared between every D target using the same cache directory"));
+
+cl::opt<unsigned> cppPartitions("cpp-partitions",
+    cl::desc("Pack the C++ modules into <n> objects named after the first object file instead of one object per module, and emit each C++ template instance into only one of the objects"),
+    cl::value_desc("n"), cl::init(0));
+
 static cl::extrahelp footer(
     "\n"
     "-d-debug can also be specified without options, in which case it enables "
@@ -72,6 +72,18 @@ extern cl::opt<FloatABI::Type> mFloatABI;
 extern cl::opt<bool, true> singleObj;
 extern cl::opt<bool> linkonceTemplates;
 extern cl::opt<bool> disableLinkerStripDead;
+extern cl::opt<bool> externalArchiver;
+extern cl::opt<bool> inMemoryObjects;
+extern cl::opt<std::string> ir2objCacheDir;
+extern cl::opt<bool> timeTrace;
+extern cl::opt<std::string> timeTraceFile;
+extern cl::opt<unsigned> timeTraceGranularity;
+extern cl::opt<unsigned> semantic3Jobs;
+extern cl::opt<bool> memoryReport;
+extern cl::opt<std::string> memoryReportFile;
+
+// Final command line, config file switches included
+extern std::vector<const char *> allArguments;
 
 extern cl::opt<BOUNDSCHECK> boundsCheck;
 extern bool nonSafeBoundsChecks;
@@ -82,6 +94,9 @@ extern cl::opt<unsigned, true> nestedTemplateDepth;
 extern cl::list<std::string> cppArgs;
 extern cl::opt<std::string> cppCacheDir;
 extern cl::opt<bool> cppVerboseDiags; // mostly diags from failed instantiations that can be ignored
+extern cl::opt<bool> cppModules;
+extern cl::opt<unsigned> cppPartitions;
+extern cl::opt<std::string> cppServer;
 
 // Arguments to -d-debug
 extern std::vector<std::string> debugArgs;
@@ -88,7 +88,8 @@ void emitSymbolAddrGlobal(llvm::Module &lm, const char *symbolName,
 namespace ldc {
 CodeGenerator::CodeGenerator(llvm::LLVMContext &context, bool singleObj)
     : context_(context), moduleCount_(0), singleObj_(singleObj), ir_(nullptr),
-      firstModuleObjfileName_(nullptr) {
+      firstModuleObjfileName_(nullptr), objFilename_(nullptr),
+      lastModule_(nullptr) {
   if (!ClassDeclaration::object) {
     error(Loc(), "declaration for class Object not found; druntime not "
                  "configured properly");
@@ -96,11 +97,24 @@ CodeGenerator::CodeGenerator(llvm::LLVMContext &context, bool singleObj)
   }
 }
 
+CodeGenerator::CodeGenerator(llvm::LLVMContext &context,
+                             const char *objFilename)
+    : CodeGenerator(context, true) {
+  objFilename_ = objFilename;
+}
+
 CodeGenerator::~CodeGenerator() {
-  if (singleObj_) {
+  if (singleObj_ && ir_) {
+    // CALYPSO the foreign code generators are entered once per LLVM module
+    for (auto lp: global.langPlugins)
+      lp->codegen()->leaveModule(lastModule_, &ir_->module);
+
     const char *oname;
     const char *filename;
-    if ((oname = global.params.exefile) || (oname = global.params.objname)) {
+    if (objFilename_) {
+      filename = objFilename_;
+    } else if ((oname = global.params.exefile) ||
+               (oname = global.params.objname)) {
       filename = FileName::forceExt(
           oname, global.params.targetTriple.isOSWindows() ? global.obj_ext_alt
                                                           : global.obj_ext);
@@ -121,6 +135,7 @@ void CodeGenerator::prepareLLModule(Module *m) {
     firstModuleObjfileName_ = m->objfile->name->str;
   }
   ++moduleCount_;
+  lastModule_ = m;
 
   if (singleObj_ && ir_) {
     return;
@@ -150,13 +165,13 @@ void CodeGenerator::prepareLLModule(Module *m) {
 }
 
 void CodeGenerator::finishLLModule(Module *m) {
-  for (auto lp: global.langPlugins) // CALYPSO
-    lp->codegen()->leaveModule(m, &ir_->module);
-
   if (singleObj_) {
     return;
   }
 
+  for (auto lp: global.langPlugins) // CALYPSO
+    lp->codegen()->leaveModule(m, &ir_->module);
+
   m->deleteObjFile();
   writeAndFreeLLModule(m->objfile->name->str);
 }
@@ -27,6 +27,8 @@ namespace ldc {
 class CodeGenerator {
 public:
   CodeGenerator(llvm::LLVMContext &context, bool singleObj);
+  /// Emits all the modules into a single object named objFilename.
+  CodeGenerator(llvm::LLVMContext &context, const char *objFilename);
   ~CodeGenerator();
   void emit(Module *m);
 
@@ -40,6 +42,8 @@ private:
   bool const singleObj_;
   IRState *ir_;
   const char *firstModuleObjfileName_;
+  const char *objFilename_;
+  Module *lastModule_;
 };
 }
 
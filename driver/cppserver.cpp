@@ -0,0 +1,497 @@
+//===-- cppserver.cpp -----------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Protocol, over a Unix domain socket:
+//  client -> server: its stdin/stdout/stderr as SCM_RIGHTS ancillary data,
+//                    then the identity of the compiler, the working
+//                    directory, the command line and the environment as
+//                    length-prefixed strings
+//  server -> client: the exit status of the compilation, or retryStatus if
+//                    the server can't take the request and the client should
+//                    compile by itself, e.g. if the client is another build
+//                    of ldc2 or if its C++ settings differ from the server's.
+//
+//===----------------------------------------------------------------------===//
+
+#include "driver/cppserver.h"
+#include "driver/cl_options.h"
+#include "driver/exe_path.h"
+#include "driver/ldc-version.h"
+#include "errors.h"
+#include "mars.h"
+#include "cpp/calypso.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#if LDC_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const char *serverEnvVar = "LDC_CPP_SERVER";
+
+#if LDC_POSIX
+
+extern char **environ;
+
+static const int32_t retryStatus = -1;
+
+static std::vector<char *> clientArgv; // command line of the forked compilation
+static std::vector<char *> clientEnv;  // environment of the forked compilation
+static std::vector<std::string> serverSettings; // see cppSettings()
+static int declineFd = -1; // written to by declineCompilation()
+
+//////////////////////////////////////////////////////////////////////////////
+
+static bool writeAll(int fd, const void *buf, size_t n) {
+  auto p = static_cast<const char *>(buf);
+  while (n) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return false;
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+static bool readAll(int fd, void *buf, size_t n) {
+  auto p = static_cast<char *>(buf);
+  while (n) {
+    ssize_t r = read(fd, p, n);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+static bool writeString(int fd, const char *str) {
+  uint32_t len = strlen(str);
+  return writeAll(fd, &len, sizeof(len)) && writeAll(fd, str, len);
+}
+
+static bool readString(int fd, std::string &str) {
+  uint32_t len;
+  if (!readAll(fd, &len, sizeof(len)) || len > (1 << 20))
+    return false;
+  str.resize(len);
+  return len == 0 || readAll(fd, &str[0], len);
+}
+
+static bool writeStrings(int fd, char **strs, uint32_t n) {
+  if (!writeAll(fd, &n, sizeof(n)))
+    return false;
+  for (uint32_t i = 0; i < n; i++) {
+    if (!writeString(fd, strs[i]))
+      return false;
+  }
+  return true;
+}
+
+static bool readStrings(int fd, std::vector<std::string> &strs) {
+  uint32_t n;
+  if (!readAll(fd, &n, sizeof(n)) || n > 65536)
+    return false;
+  strs.resize(n);
+  for (auto &str : strs) {
+    if (!readString(fd, str))
+      return false;
+  }
+  return true;
+}
+
+// A client must be the same build of ldc2 as the server, which would
+// otherwise compile with its own binary and configuration file.
+static std::string compilerIdentity(const char *argv0) {
+  std::string identity = llvm::sys::fs::getMainExecutable(
+      argv0, reinterpret_cast<void *>(&compilerIdentity));
+  identity += '\n';
+  identity += ldc::ldc_version;
+  return identity;
+}
+
+// The cache directory resolved against the current directory, since the
+// compilations forked by the server run in the directory of their client.
+static void makeCppCacheDirAbsolute() {
+  llvm::SmallString<128> cacheDir(opts::cppCacheDir);
+  llvm::sys::fs::make_absolute(cacheDir);
+  opts::cppCacheDir = cacheDir.str().str();
+}
+
+static bool makeSocketAddress(const char *socketPath, sockaddr_un &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path))
+    return false;
+  strcpy(addr.sun_path, socketPath);
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool forwardToCompileServer(int argc, char **argv, int &status) {
+  const char *socketPath = getenv(serverEnvVar);
+  if (!socketPath || !*socketPath)
+    return false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-cpp-server", 11) == 0)
+      return false; // don't let a server forward to another
+  }
+
+  sockaddr_un addr;
+  if (!makeSocketAddress(socketPath, addr))
+    return false;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    close(fd); // no server running, compile locally
+    return false;
+  }
+
+  // Hand over our standard streams so that diagnostics reach our caller.
+  int stdFds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  char marker = 0;
+  iovec iov = {&marker, 1};
+  char control[CMSG_SPACE(sizeof(stdFds))];
+  memset(control, 0, sizeof(control));
+
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(stdFds));
+  memcpy(CMSG_DATA(cmsg), stdFds, sizeof(stdFds));
+
+  char cwd[PATH_MAX];
+  uint32_t nenv = 0;
+  while (environ[nenv])
+    nenv++;
+  bool sent = sendmsg(fd, &msg, 0) == 1 && getcwd(cwd, sizeof(cwd)) &&
+              writeString(fd, compilerIdentity(argv[0]).c_str()) &&
+              writeString(fd, cwd) && writeStrings(fd, argv, argc) &&
+              writeStrings(fd, environ, nenv);
+
+  if (!sent) {
+    close(fd);
+    return false;
+  }
+
+  int32_t result;
+  if (!readAll(fd, &result, sizeof(result))) {
+    close(fd);
+    error(Loc(), "lost connection to the compile server at %s", socketPath);
+    status = EXIT_FAILURE;
+    return true;
+  }
+  close(fd);
+
+  if (result == retryStatus)
+    return false;
+
+  status = result;
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static bool readRequest(int conn, int (&stdFds)[3], std::string &identity,
+                        std::string &cwd, std::vector<std::string> &args,
+                        std::vector<std::string> &env) {
+  char marker;
+  iovec iov = {&marker, 1};
+  char control[CMSG_SPACE(sizeof(stdFds))];
+
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (recvmsg(conn, &msg, 0) != 1)
+    return false;
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(stdFds)))
+    return false;
+  memcpy(stdFds, CMSG_DATA(cmsg), sizeof(stdFds));
+
+  return readString(conn, identity) && readString(conn, cwd) &&
+         readStrings(conn, args) && !args.empty() && readStrings(conn, env);
+}
+
+// The loaded AST stays valid as long as the cache files it was loaded from
+// don't change.
+struct CacheStamp {
+  struct FileStamp {
+    time_t mtime = 0;
+    long mtimeNsec = 0;
+    off_t size = 0;
+
+    void get(const std::string &filename) {
+      struct stat st;
+      if (stat(filename.c_str(), &st) == 0) {
+        mtime = st.st_mtime;
+#if __APPLE__
+        mtimeNsec = st.st_mtimespec.tv_nsec;
+#else
+        mtimeNsec = st.st_mtim.tv_nsec;
+#endif
+        size = st.st_size;
+      }
+    }
+
+    bool operator==(const FileStamp &other) const {
+      return mtime == other.mtime && mtimeNsec == other.mtimeNsec &&
+             size == other.size;
+    }
+  };
+
+  FileStamp headerList, moduleMaps, pch, layers;
+
+  static CacheStamp get() {
+    CacheStamp stamp;
+    stamp.headerList.get(cpp::calypso.getCacheFilename());
+    stamp.moduleMaps.get(cpp::calypso.getCacheFilename(".modulemaps"));
+    stamp.pch.get(cpp::calypso.getCacheFilename(".h.pch"));
+    stamp.layers.get(cpp::calypso.getCacheFilename(".h.pch.layers"));
+    return stamp;
+  }
+
+  bool operator==(const CacheStamp &other) const {
+    return headerList == other.headerList && moduleMaps == other.moduleMaps &&
+           pch == other.pch && layers == other.layers;
+  }
+};
+
+// The settings the loaded AST depends on, which the clients must share. The
+// cache directory has been made absolute.
+static std::vector<std::string> cppSettings() {
+  std::vector<std::string> settings;
+  settings.push_back(global.params.targetTriple.str());
+  settings.push_back(opts::cppCacheDir);
+  settings.push_back(opts::cppModules ? "modules" : "");
+  settings.insert(settings.end(), opts::cppArgs.begin(), opts::cppArgs.end());
+  return settings;
+}
+
+bool runCompileServer(const char *socketPath, int &argc, char **&argv) {
+  std::vector<char *> serverArgv(argv, argv + argc);
+  serverArgv.push_back(nullptr);
+
+  sockaddr_un addr;
+  if (!makeSocketAddress(socketPath, addr)) {
+    error(Loc(), "compile server socket path too long: %s", socketPath);
+    return false;
+  }
+
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath);
+  if (listenFd < 0 ||
+      bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(listenFd, SOMAXCONN) < 0) {
+    error(Loc(), "compile server couldn't listen on %s: %s", socketPath,
+          strerror(errno));
+    return false;
+  }
+
+  // Load the PCH now, every compilation process will start with it.
+  makeCppCacheDirAbsolute();
+  cpp::calypso.pch.update();
+  cpp::calypso.pch.preloaded = true;
+  auto stamp = CacheStamp::get();
+  serverSettings = cppSettings();
+  const std::string identity = compilerIdentity(argv[0]);
+
+  if (global.params.verbose) {
+    fprintf(global.stdmsg, "compile server listening on %s\n", socketPath);
+  }
+  fflush(stdout);
+  fflush(stderr);
+
+  signal(SIGCHLD, SIG_IGN); // request handlers are reaped automatically
+
+  while (true) {
+    int conn = accept(listenFd, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      error(Loc(), "compile server: %s", strerror(errno));
+      return false;
+    }
+
+    if (!(CacheStamp::get() == stamp)) {
+      // The headers or the PCH changed and the AST can't be updated in place.
+      // Let the client compile by itself and restart to load the new PCH.
+      int32_t result = retryStatus;
+      writeAll(conn, &result, sizeof(result));
+      close(conn);
+      close(listenFd);
+      unlink(socketPath);
+      execv(exe_path::getExePath().c_str(), serverArgv.data());
+      error(Loc(), "compile server couldn't restart: %s", strerror(errno));
+      return false;
+    }
+
+    pid_t handler = fork();
+    if (handler != 0) {
+      if (handler < 0) {
+        int32_t result = retryStatus;
+        writeAll(conn, &result, sizeof(result));
+      }
+      close(conn);
+      continue;
+    }
+
+    // Request handler: fork the compilation process, wait for it and report
+    // its exit status to the client.
+    close(listenFd);
+    signal(SIGCHLD, SIG_DFL);
+
+    int stdFds[3];
+    std::string clientIdentity, cwd;
+    std::vector<std::string> args, env;
+    if (!readRequest(conn, stdFds, clientIdentity, cwd, args, env))
+      _exit(EXIT_FAILURE);
+
+    if (clientIdentity != identity) {
+      int32_t result = retryStatus;
+      writeAll(conn, &result, sizeof(result));
+      _exit(EXIT_SUCCESS);
+    }
+
+    int declinePipe[2];
+    if (pipe(declinePipe) < 0)
+      _exit(EXIT_FAILURE);
+
+    pid_t compiler = fork();
+    if (compiler == 0) {
+      close(conn);
+      close(declinePipe[0]);
+      declineFd = declinePipe[1];
+      fcntl(declineFd, F_SETFD, FD_CLOEXEC);
+      for (int i = 0; i < 3; i++) {
+        dup2(stdFds[i], i);
+        close(stdFds[i]);
+      }
+      if (chdir(cwd.c_str()) < 0) {
+        error(Loc(), "cannot change directory to %s", cwd.c_str());
+        _exit(EXIT_FAILURE);
+      }
+
+      clientArgv.clear();
+      for (auto &arg : args)
+        clientArgv.push_back(strdup(arg.c_str()));
+      clientArgv.push_back(nullptr);
+
+      // The linker, TMPDIR and the program run by -run see the client's
+      // environment.
+      clientEnv.clear();
+      for (auto &var : env)
+        clientEnv.push_back(strdup(var.c_str()));
+      clientEnv.push_back(nullptr);
+      environ = clientEnv.data();
+
+      argc = args.size();
+      argv = clientArgv.data();
+      return true;
+    }
+
+    for (int i = 0; i < 3; i++)
+      close(stdFds[i]);
+    close(declinePipe[1]);
+
+    int32_t result = retryStatus; // fork failed
+    int wstatus;
+    if (compiler > 0) {
+      while (waitpid(compiler, &wstatus, 0) < 0 && errno == EINTR) {
+      }
+      char declined;
+      if (read(declinePipe[0], &declined, 1) != 1) {
+        result = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus)
+                                    : 128 + WTERMSIG(wstatus);
+      }
+    }
+    writeAll(conn, &result, sizeof(result));
+    _exit(EXIT_SUCCESS);
+  }
+}
+
+bool hasServerCppSettings() {
+  makeCppCacheDirAbsolute();
+  return cppSettings() == serverSettings;
+}
+
+void declineCompilation() {
+  char declined = 1;
+  if (write(declineFd, &declined, 1) != 1) {
+    // The client won't retry, so compile by ourselves
+    restartCompilationWithoutServer();
+  }
+  _exit(EXIT_FAILURE);
+}
+
+void restartCompilationWithoutServer() {
+  fflush(stdout);
+  fflush(stderr);
+  unsetenv(serverEnvVar);
+  execv(exe_path::getExePath().c_str(), clientArgv.data());
+  error(Loc(), "couldn't restart the compilation: %s", strerror(errno));
+  fatal();
+}
+
+#else
+
+bool forwardToCompileServer(int argc, char **argv, int &status) {
+  return false;
+}
+
+bool runCompileServer(const char *socketPath, int &argc, char **&argv) {
+  error(Loc(), "the compile server is only supported on POSIX systems");
+  return false;
+}
+
+bool hasServerCppSettings() { return true; }
+
+void declineCompilation() {
+  fatal();
+}
+
+void restartCompilationWithoutServer() {
+  fatal();
+}
+
+#endif
@@ -0,0 +1,50 @@
+//===-- driver/cppserver.h - Calypso compile server -------------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Long-running server keeping the C++ AST loaded between compilations.
+//
+// The DMD frontend can't be reset between compilations, so instead of
+// compiling in-process the server forks a process for each request once the
+// PCH is loaded, which starts compiling with the AST already in memory
+// (shared copy-on-write with the server).
+// Clients are regular ldc2 invocations (or ldmd, which runs ldc2) with the
+// LDC_CPP_SERVER environment variable set to the socket path.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_DRIVER_CPPSERVER_H
+#define LDC_DRIVER_CPPSERVER_H
+
+/// If LDC_CPP_SERVER is set, sends the command line to the compile server and
+/// waits for the compilation to end. Returns false if there's no server to
+/// forward to, in which case the compilation should happen locally.
+bool forwardToCompileServer(int argc, char **argv, int &status);
+
+/// Listens on socketPath for compilation requests. Only returns in the forked
+/// compilation processes, with argc/argv replaced by the client's command line
+/// and the client's working directory, environment and standard streams.
+/// Clients from another build of ldc2 are told to compile by themselves.
+/// Returns false if the server couldn't be started.
+bool runCompileServer(const char *socketPath, int &argc, char **&argv);
+
+/// Whether the target, Clang arguments and cache directory of the forked
+/// compilation process are those the server loaded the AST with. The cache
+/// directory is resolved against the client's working directory first.
+bool hasServerCppSettings();
+
+/// Called by a forked compilation process that can't use the loaded AST,
+/// because of different C++ settings. Tells the client to compile by itself.
+void declineCompilation();
+
+/// Called by a forked compilation process whose modmaps add headers to the
+/// PCH, since the preloaded AST can't be updated. Re-executes the compiler
+/// with the client's command line, without the server.
+void restartCompilationWithoutServer();
+
+#endif
@@ -0,0 +1,158 @@
+//===-- ir2obj_cache.cpp --------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "driver/ir2obj_cache.h"
+#include "driver/cl_options.h"
+#include "driver/ldc-version.h"
+#include "gen/logger.h"
+#include "mars.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+/// Switches which don't influence the generated object code: output naming,
+/// verbosity, the cache itself. Input files are skipped as well since they
+/// don't start with a dash, their content is already part of the bitcode.
+/// The verbosity switches are matched exactly, as many LLVM options affecting
+/// the optimizer start with -v too (e.g. -vectorize-loops).
+bool isIrrelevantArgument(llvm::StringRef arg) {
+  static const char *const switches[] = {"-v",   "-vv",  "-v-cg", "-vcolumns",
+                                         "-vgc", "-vtls", "-op",  "-oq",
+                                         "-run"};
+  static const char *const prefixes[] = {
+      "-of",          "-od",           "-cache",        "-verrors",
+      "-cpp-server",  "-ftime-trace",  "-memory-report", "-semantic3-jobs"};
+
+  if (!arg.startswith("-"))
+    return true;
+  for (auto sw : switches) {
+    if (arg == sw)
+      return true;
+  }
+  for (auto prefix : prefixes) {
+    if (arg.startswith(prefix))
+      return true;
+  }
+  return false;
+}
+
+void storeCacheFileName(llvm::StringRef cacheObjectHash,
+                        llvm::SmallString<128> &filePath) {
+  filePath = opts::ir2objCacheDir;
+  llvm::sys::path::append(filePath, llvm::Twine("ircache_") +
+                                        cacheObjectHash + "." +
+                                        global.obj_ext);
+}
+
+bool copyFile(llvm::StringRef from, llvm::StringRef to) {
+  auto buffer = llvm::MemoryBuffer::getFile(from);
+  if (!buffer)
+    return false;
+
+  std::error_code errinfo;
+  llvm::raw_fd_ostream out(to, errinfo, llvm::sys::fs::F_None);
+  if (errinfo)
+    return false;
+  out << (*buffer)->getBuffer();
+  return !out.has_error();
+}
+}
+
+namespace ir2obj {
+
+void calculateModuleHash(llvm::Module *m, llvm::SmallString<32> &str) {
+  IF_LOG Logger::println("Calculate module hash");
+  LOG_SCOPE
+
+  llvm::SmallString<4096> bitcode;
+  {
+    llvm::raw_svector_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(m, os);
+  }
+
+  llvm::MD5 hasher;
+  hasher.update(bitcode);
+
+  // Optimization and code generation flags, and the compiler itself.
+  hasher.update(ldc::ldc_version);
+  hasher.update(ldc::llvm_version);
+  for (auto arg : opts::allArguments) {
+    if (isIrrelevantArgument(arg))
+      continue;
+    hasher.update(arg);
+    hasher.update(llvm::StringRef("", 1)); // separator
+  }
+
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+  llvm::MD5::stringifyResult(result, str);
+
+  IF_LOG Logger::println("Hash: %s", str.c_str());
+}
+
+std::string cacheLookup(llvm::StringRef cacheObjectHash) {
+  llvm::SmallString<128> filePath;
+  storeCacheFileName(cacheObjectHash, filePath);
+  if (!llvm::sys::fs::exists(filePath.c_str()))
+    return std::string();
+
+  IF_LOG Logger::println("Cache hit: %s", filePath.c_str());
+  return filePath.str().str();
+}
+
+void cacheObjectFile(llvm::StringRef objectFile,
+                     llvm::StringRef cacheObjectHash) {
+  if (!llvm::sys::fs::exists(opts::ir2objCacheDir) &&
+      llvm::sys::fs::create_directories(opts::ir2objCacheDir)) {
+    error(Loc(), "unable to create cache directory: %s",
+          opts::ir2objCacheDir.c_str());
+    fatal();
+  }
+
+  // Write to a unique file then rename it, so that concurrent compilations
+  // never see a partially written cache file.
+  llvm::SmallString<128> tmpPath(opts::ir2objCacheDir);
+  llvm::sys::path::append(tmpPath, "ircache-%%%%%%%%.tmp");
+  int tmpFd;
+  if (llvm::sys::fs::createUniqueFile(tmpPath, tmpFd, tmpPath))
+    return; // the cache is an optimization, don't fail the compilation
+  llvm::sys::Process::SafelyCloseFileDescriptor(tmpFd);
+
+  llvm::SmallString<128> cacheFile;
+  storeCacheFileName(cacheObjectHash, cacheFile);
+
+  IF_LOG Logger::println("Copy object file to cache: %s", cacheFile.c_str());
+  if (!copyFile(objectFile, tmpPath) ||
+      llvm::sys::fs::rename(tmpPath, cacheFile)) {
+    llvm::sys::fs::remove(tmpPath);
+  }
+}
+
+bool recoverObjectFile(llvm::StringRef cacheObjectHash,
+                       llvm::StringRef objectFile) {
+  llvm::SmallString<128> cacheFile;
+  storeCacheFileName(cacheObjectHash, cacheFile);
+
+  IF_LOG Logger::println("Copy cached object file to: %s",
+                         objectFile.str().c_str());
+  if (!copyFile(cacheFile, objectFile)) {
+    llvm::sys::fs::remove(objectFile);
+    return false;
+  }
+
+  return true;
+}
+}
@@ -0,0 +1,41 @@
+//===-- driver/ir2obj_cache.h - Object file cache ---------------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Caches the object files generated from LLVM modules, keyed on a hash of the
+// unoptimized module bitcode and of the options influencing optimization and
+// code generation. A cache hit skips the LLVM optimizer and backend.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_DRIVER_IR2OBJ_CACHE_H
+#define LDC_DRIVER_IR2OBJ_CACHE_H
+
+#include "llvm/ADT/SmallString.h"
+
+namespace llvm {
+class Module;
+}
+
+namespace ir2obj {
+
+void calculateModuleHash(llvm::Module *m, llvm::SmallString<32> &str);
+
+/// Returns the path of the cached object file for the hash, or an empty
+/// string if there is none.
+std::string cacheLookup(llvm::StringRef cacheObjectHash);
+
+void cacheObjectFile(llvm::StringRef objectFile,
+                     llvm::StringRef cacheObjectHash);
+
+/// Copies the cached object file to objectFile, returns false on failure.
+bool recoverObjectFile(llvm::StringRef cacheObjectHash,
+                       llvm::StringRef objectFile);
+}
+
+#endif
@@ -14,12 +14,15 @@
 #include "root.h"
 #include "driver/cl_options.h"
 #include "driver/exe_path.h"
+#include "driver/toobj.h"
 #include "driver/tool.h"
 #include "gen/llvm.h"
 #include "gen/logger.h"
 #include "gen/optimizer.h"
 #include "gen/programs.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Path.h"
@@ -611,6 +614,51 @@ int linkObjToBinary(bool sharedLib, bool fullyStatic) {
 
 //////////////////////////////////////////////////////////////////////////////
 
+bool useInternalArchiver() {
+  return !opts::externalArchiver &&
+         !global.params.targetTriple.isWindowsMSVCEnvironment();
+}
+
+// Writes the archive and its symbol table directly, from the object files kept
+// in memory by writeModule() or read from disk.
+static int writeArchive(const std::string &libName) {
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+  std::vector<llvm::NewArchiveMember> members;
+
+  for (unsigned i = 0; i < global.params.objfiles->dim; i++) {
+    const char *p = static_cast<const char *>(global.params.objfiles->data[i]);
+
+    auto buffer = takeInMemoryObject(p);
+    if (!buffer) {
+      auto fileBuffer = llvm::MemoryBuffer::getFile(p);
+      if (!fileBuffer) {
+        error(Loc(), "cannot read object file '%s': %s", p,
+              fileBuffer.getError().message().c_str());
+        return EXIT_FAILURE;
+      }
+      buffer = std::move(*fileBuffer);
+    }
+
+    // Name the member after the file like ar does, not after its full path
+    members.emplace_back(llvm::MemoryBufferRef(buffer->getBuffer(),
+                                               llvm::sys::path::filename(p)));
+    buffers.push_back(std::move(buffer));
+  }
+
+  auto kind = global.params.targetTriple.isOSDarwin()
+                  ? llvm::object::Archive::K_BSD
+                  : llvm::object::Archive::K_GNU;
+
+  auto result = llvm::writeArchive(libName, members, /*WriteSymtab=*/true, kind,
+                                   /*Deterministic=*/true, /*Thin=*/false);
+  if (result.second) {
+    error(Loc(), "cannot write static library '%s': %s",
+          result.first.str().c_str(), result.second.message().c_str());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
 int createStaticLibrary() {
   Logger::println("*** Creating static library ***");
 
@@ -668,15 +716,22 @@ int createStaticLibrary() {
     args.push_back(libName);
   }
 
+  // create path to the library
+  CreateDirectoryOnDisk(libName);
+
+  if (useInternalArchiver()) {
+    if (global.params.verbose) {
+      fprintf(global.stdmsg, "archive   %s\n", libName.c_str());
+    }
+    return writeArchive(libName);
+  }
+
   // object files
   for (unsigned i = 0; i < global.params.objfiles->dim; i++) {
     const char *p = static_cast<const char *>(global.params.objfiles->data[i]);
     args.push_back(p);
   }
 
-  // create path to the library
-  CreateDirectoryOnDisk(libName);
-
   // try to call archiver
   int exitCode;
   if (isTargetWindows) {
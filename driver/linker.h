@@ -27,6 +27,12 @@ int linkObjToBinary(bool sharedLib, bool fullyStatic);
  */
 int createStaticLibrary();
 
+/**
+ * Whether static libraries are written by LDC itself rather than by ar or
+ * lib.exe, which is the case for every target but MSVC.
+ */
+bool useInternalArchiver();
+
 /**
  * Delete the executable that was previously linked with linkObjToBinary.
  */
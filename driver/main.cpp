@@ -8,6 +8,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "module.h"
+#include "expression.h"
+#include "ctfe.h"
 #include "errors.h"
 #include "doc.h"
 #include "id.h"
@@ -19,15 +21,18 @@
 #include "rmem.h"
 #include "root.h"
 #include "scope.h"
+#include "template.h"
 #include "cpp/calypso.h"
 #include "cpp/cppmodule.h"
 #include "dmd2/target.h"
 #include "driver/cl_options.h"
 #include "driver/codegenerator.h"
 #include "driver/configfile.h"
+#include "driver/cppserver.h"
 #include "driver/exe_path.h"
 #include "driver/ldc-version.h"
 #include "driver/linker.h"
+#include "driver/memoryreport.h"
 #include "driver/targetmachine.h"
 #include "gen/cl_helpers.h"
 #include "gen/irstate.h"
@@ -39,6 +44,7 @@
 #include "gen/optimizer.h"
 #include "gen/passes/Passes.h"
 #include "gen/runtime.h"
+#include "gen/timetrace.h"
 #include "gen/abi.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/LinkAllPasses.h"
@@ -58,8 +64,15 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
 #if LDC_POSIX
 #include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #elif _WIN32
 #include <windows.h>
 #endif
@@ -335,6 +348,7 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
                     cfg_file.switches_end());
 
   final_args.insert(final_args.end(), &argv[1], &argv[argc]);
+  opts::allArguments = final_args;
 
   cl::SetVersionPrinter(&printVersion);
   hideLLVMOptions();
@@ -545,6 +559,11 @@ static void parseCommandLine(int argc, char **argv, Strings &sourceFiles,
   if (soname.getNumOccurrences() > 0 && !createSharedLib) {
     error(Loc(), "-soname can be used only when building a shared library");
   }
+
+  // The pass needs to see every subclass, i.e. the whole program at once
+  if (opts::devirtualize != opts::NoDevirtualization && !singleObj) {
+    error(Loc(), "-d-devirtualize can only be used with -singleobj");
+  }
 }
 
 static void initializePasses() {
@@ -926,46 +945,8 @@ static void emitJson(Modules &modules) {
   }
 }
 
-int main(int argc, char **argv) {
-  global.langPlugins.push_back(&cpp::calypso);
-
-  // stack trace on signals
-#if LDC_LLVM_VER >= 309
-  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
-#else
-  llvm::sys::PrintStackTraceOnErrorSignal();
-#endif
-
-  exe_path::initialize(argv[0], reinterpret_cast<void *>(main));
-
-  global.init();
-  global.version = ldc::dmd_version;
-  global.ldc_version = ldc::ldc_version;
-  global.llvm_version = ldc::llvm_version;
-
-  // Initialize LLVM before parsing the command line so that --version shows
-  // registered targets.
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmPrinters();
-  llvm::InitializeAllAsmParsers();
-
-  initializePasses();
-
-  bool helpOnly;
-  Strings files;
-  parseCommandLine(argc, argv, files, helpOnly);
-
-  if (files.dim == 0 && !helpOnly) {
-    cl::PrintHelpMessage();
-    return EXIT_FAILURE;
-  }
-
-  if (global.errors) {
-    fatal();
-  }
-
+/// Sets up the target machine and the predefined versions.
+static void setupTarget() {
   // Set up the TargetMachine.
   ExplicitBitness::Type bitness = ExplicitBitness::None;
   if ((m32bits || m64bits) && (!mArch.empty() || !mTargetTriple.empty())) {
@@ -993,6 +974,8 @@ int main(int argc, char **argv) {
 
 #if LDC_LLVM_VER >= 308
   static llvm::DataLayout DL = gTargetMachine->createDataLayout();
+  DL = gTargetMachine->createDataLayout(); // CALYPSO may be set up again by a
+                                           // compile server process
   gDataLayout = &DL;
 #elif LDC_LLVM_VER >= 307
   gDataLayout = gTargetMachine->getDataLayout();
@@ -1024,6 +1007,229 @@ int main(int argc, char **argv) {
     global.dll_ext = "so";
     global.lib_ext = "a";
   }
+}
+
+/// Returns the number of worker processes running semantic3 and codegen of
+/// the root modules (-semantic3-jobs), or 1 to run them in this process.
+static unsigned semantic3WorkerCount(Modules &modules) {
+#if LDC_POSIX
+  unsigned jobs = semantic3Jobs;
+  if (jobs == 0) {
+    jobs = std::thread::hardware_concurrency();
+  }
+  jobs = std::min<unsigned>(jobs, modules.dim);
+  if (jobs <= 1) {
+    return 1;
+  }
+
+  // The frontend state of the workers is lost when they exit, so everything
+  // needing it after semantic3 has to run in this process. The C++ modules
+  // are only known to need codegen after all the D modules were analyzed.
+  if (singleObj || !global.params.obj || inMemoryObjects ||
+      cpp::Module::amodules.dim || global.params.moduleDepsFile ||
+      global.params.doDocComments || global.params.doJsonGeneration ||
+      timeTrace || memoryReport || !memoryReportFile.empty()) {
+    if (global.params.verbose) {
+      fprintf(global.stdmsg,
+              "semantic3 workers disabled by the imported C++ modules or the "
+              "requested outputs\n");
+    }
+    return 1;
+  }
+  return jobs;
+#else
+  return 1;
+#endif
+}
+
+#if LDC_POSIX
+/// Runs semantic3 and codegen of the root modules in forked worker processes
+/// pulling the modules from a shared queue. Each worker starts from a copy of
+/// the frontend state after semantic2, so they need no synchronization.
+/// Template instances first instantiated by several workers are emitted by
+/// each of them, which their weak linkage allows.
+/// Returns whether all the workers succeeded.
+static bool runSemantic3Workers(Modules &modules, unsigned jobs,
+                                const std::function<void(Module *)> &semantic3,
+                                const std::function<void(Modules &)> &emit) {
+  int queue[2];
+  if (pipe(queue) < 0) {
+    error(Loc(), "cannot create the semantic3 queue: %s", strerror(errno));
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  std::vector<pid_t> workers;
+  for (unsigned i = 0; i < jobs; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      break;
+    }
+    if (pid > 0) {
+      workers.push_back(pid);
+      continue;
+    }
+
+    // Worker
+    close(queue[1]);
+    Modules pulled;
+    uint32_t index;
+    while (true) {
+      ssize_t n = read(queue[0], &index, sizeof(index));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n != sizeof(index)) {
+        break;
+      }
+      pulled.push(modules[index]);
+      semantic3(modules[index]);
+    }
+    if (!global.errors) {
+      Module::runDeferredSemantic3();
+    }
+    if (!global.errors && !global.warnings) {
+      emit(pulled);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    _exit(global.errors || global.warnings ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+  close(queue[0]);
+
+  if (workers.empty()) {
+    close(queue[1]);
+    error(Loc(), "cannot start the semantic3 workers: %s", strerror(errno));
+    return false;
+  }
+
+  // Writes of a single index are atomic, so each worker reads whole indices.
+  // If all the workers died, writing fails instead of raising SIGPIPE.
+  auto oldHandler = signal(SIGPIPE, SIG_IGN);
+  for (uint32_t i = 0; i < modules.dim; i++) {
+    ssize_t n;
+    while ((n = write(queue[1], &i, sizeof(i))) < 0 && errno == EINTR) {
+    }
+    if (n != sizeof(i)) {
+      break;
+    }
+  }
+  close(queue[1]);
+  signal(SIGPIPE, oldHandler);
+
+  bool success = true;
+  for (pid_t pid : workers) {
+    int wstatus;
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {
+    }
+    success &= WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS;
+  }
+  return success;
+}
+#endif
+
+/// CALYPSO Emits the C++ modules into -cpp-partitions objects named after the
+/// first object file, instead of one object per module. Neighbouring modules,
+/// likely to share template instances, are kept in the same partition.
+/// Which partition defines each template instance only depends on its mangled
+/// name, so the partitions except the last one could be emitted in any order.
+static void emitCppPartitions(const char *firstObjfile) {
+  Modules &cppModules = cpp::Module::amodules;
+  unsigned const partitions = std::min<unsigned>(cppPartitions, cppModules.dim);
+  cpp::calypso.numPartitions = partitions;
+
+  for (unsigned k = 0; k < partitions; k++) {
+    cpp::calypso.partition = k;
+
+    llvm::SmallString<128> filename(firstObjfile);
+    llvm::sys::path::replace_extension(filename, "");
+    filename += "_cpp" + std::to_string(k);
+    filename += llvm::sys::path::extension(firstObjfile);
+
+    ldc::CodeGenerator cg(getGlobalContext(), mem.xstrdup(filename.c_str()));
+    for (unsigned i = k * cppModules.dim / partitions;
+         i < (k + 1) * cppModules.dim / partitions; i++) {
+      Module *const m = cppModules[i];
+      if (global.params.verbose) {
+        fprintf(global.stdmsg, "code      %s (%s)\n", m->toChars(),
+                filename.c_str());
+      }
+
+      TimeTraceScope timeScope("Codegen", [m] { return m->toChars(); });
+      cg.emit(m);
+
+      if (global.errors) {
+        fatal();
+      }
+    }
+  }
+
+  cpp::calypso.partition = -1;
+}
+
+/// The file -ftime-trace writes to, by default named after the first object
+/// file.
+static std::string timeTraceFilename(Modules &modules) {
+  if (!opts::timeTraceFile.empty()) {
+    return opts::timeTraceFile;
+  }
+
+  llvm::SmallString<128> filename("ldc");
+  if (!modules.empty() && modules[0]->objfile) {
+    filename = modules[0]->objfile->name->str;
+  }
+  llvm::sys::path::replace_extension(filename, "time-trace.json");
+  return filename.str();
+}
+
+int main(int argc, char **argv) {
+  // CALYPSO
+  int serverStatus;
+  if (forwardToCompileServer(argc, argv, serverStatus)) {
+    return serverStatus;
+  }
+
+  global.langPlugins.push_back(&cpp::calypso);
+
+  // stack trace on signals
+#if LDC_LLVM_VER >= 309
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+#else
+  llvm::sys::PrintStackTraceOnErrorSignal();
+#endif
+
+  exe_path::initialize(argv[0], reinterpret_cast<void *>(main));
+
+  global.init();
+  global.version = ldc::dmd_version;
+  global.ldc_version = ldc::ldc_version;
+  global.llvm_version = ldc::llvm_version;
+
+  // Initialize LLVM before parsing the command line so that --version shows
+  // registered targets.
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  llvm::InitializeAllAsmParsers();
+
+  initializePasses();
+
+  bool helpOnly;
+  Strings files;
+  parseCommandLine(argc, argv, files, helpOnly);
+
+  if (files.dim == 0 && !helpOnly && opts::cppServer.empty()) {
+    cl::PrintHelpMessage();
+    return EXIT_FAILURE;
+  }
+
+  if (global.errors) {
+    fatal();
+  }
+
+  setupTarget();
 
   // Initialization
   Lexer::initLexer();
@@ -1038,6 +1244,51 @@ int main(int argc, char **argv) {
 
   cpp::calypso.init(argv[0]); // CALYPSO HACK
 
+  // CALYPSO
+  if (!opts::cppServer.empty()) {
+#if LDC_LLVM_VER >= 309
+    if (!runCompileServer(opts::cppServer.c_str(), argc, argv)) {
+      return EXIT_FAILURE;
+    }
+
+    // We're now in a process forked for a client, parse its command line.
+    // The frontend and the C++ AST were initialized for the server's target
+    // and Clang arguments, which the client must share.
+    cl::ResetAllOptionOccurrences();
+    global.params.versionids = nullptr;
+    global.params.debugids = nullptr;
+    global.params.imppath = nullptr;
+    global.params.fileImppath = nullptr;
+    files.setDim(0);
+    parseCommandLine(argc, argv, files, helpOnly);
+
+    if (files.dim == 0) {
+      error(Loc(), "no source files");
+    }
+    if (global.errors) {
+      fatal();
+    }
+
+    setupTarget();
+    if (!hasServerCppSettings()) {
+      declineCompilation();
+    }
+    if (global.params.verbose) {
+      fprintf(global.stdmsg, "served    by the compile server\n");
+    }
+#else
+    error(Loc(), "-cpp-server requires LLVM 3.9 or later");
+    fatal();
+#endif
+  }
+
+  if (opts::timeTrace) {
+    initializeTimeTrace(opts::timeTraceGranularity);
+  }
+  if (opts::memoryReport || !opts::memoryReportFile.empty()) {
+    initializeMemoryReport();
+  }
+
   // Build import search path
   if (global.params.imppath) {
     for (unsigned i = 0; i < global.params.imppath->dim; i++) {
@@ -1180,6 +1431,7 @@ int main(int argc, char **argv) {
     if (global.params.verbose) {
       fprintf(global.stdmsg, "parse     %s\n", m->toChars());
     }
+    TimeTraceScope timeScope("Parse", [m] { return m->toChars(); });
     if (!Module::rootModule) {
       Module::rootModule = m;
     }
@@ -1204,6 +1456,7 @@ int main(int argc, char **argv) {
       i--;
     }
   }
+  memoryReportPhaseDone("parse");
   if (global.errors) {
     fatal();
   }
@@ -1230,8 +1483,11 @@ int main(int argc, char **argv) {
     if (global.params.verbose) {
       fprintf(global.stdmsg, "importall %s\n", modules[i]->toChars());
     }
-    modules[i]->importAll(nullptr);
+    Module *m = modules[i];
+    TimeTraceScope timeScope("Import", [m] { return m->toChars(); });
+    m->importAll(nullptr);
   }
+  memoryReportPhaseDone("import");
   if (global.errors) {
     fatal();
   }
@@ -1241,22 +1497,31 @@ int main(int argc, char **argv) {
     if (global.params.verbose) {
       fprintf(global.stdmsg, "semantic  %s\n", modules[i]->toChars());
     }
-    modules[i]->semantic();
+    Module *m = modules[i];
+    TimeTraceScope timeScope("Semantic1", [m] { return m->toChars(); });
+    m->semantic();
   }
   if (global.errors) {
     fatal();
   }
 
   Module::dprogress = 1;
-  Module::runDeferredSemantic();
+  {
+    TimeTraceScope timeScope("Deferred semantic");
+    Module::runDeferredSemantic();
+  }
+  memoryReportPhaseDone("semantic");
 
   // Do pass 2 semantic analysis
   for (unsigned i = 0; i < modules.dim; i++) {
     if (global.params.verbose) {
       fprintf(global.stdmsg, "semantic2 %s\n", modules[i]->toChars());
     }
-    modules[i]->semantic2();
+    Module *m = modules[i];
+    TimeTraceScope timeScope("Semantic2", [m] { return m->toChars(); });
+    m->semantic2();
   }
+  memoryReportPhaseDone("semantic2");
   if (global.errors) {
     fatal();
   }
@@ -1266,23 +1531,80 @@ int main(int argc, char **argv) {
     if (global.params.verbose) {
       fprintf(global.stdmsg, "semantic3 %s\n", m->toChars());
     }
+    TimeTraceScope timeScope("Semantic3", [m] { return m->toChars(); });
     m->semantic3();
   };
-  for (unsigned i = 0; i < modules.dim; i++)
-    doSemantic3(modules[i]);
-  for (unsigned i = 0; i < cpp::Module::amodules.dim; i++)
-    doSemantic3(cpp::Module::amodules[i]); // CALYPSO
-  if (global.errors) {
-    fatal();
+
+  // Generate one or more object/IR/bitcode files.
+  auto emitModules = [&](Modules &toEmit) {
+    ldc::CodeGenerator cg(getGlobalContext(), singleObj);
+
+    for (unsigned i = 0; i < toEmit.dim; i++) {
+      Module *const m = toEmit[i];
+      if (global.params.verbose) {
+        fprintf(global.stdmsg, "code      %s\n", m->toChars());
+      }
+
+      auto lp = m->langPlugin();
+      if (lp && !singleObj && !lp->needsCodegen(m)) { // CALYPSO UGLY?
+          global.params.objfiles->push(m->objfile->name->str);
+          continue;
+      }
+
+      m->deleteObjFile(); // CALYPSO
+      TimeTraceScope timeScope("Codegen", [m] { return m->toChars(); });
+      cg.emit(m);
+
+      if (global.errors) {
+        fatal();
+      }
+    }
+  };
+
+  unsigned const semantic3Workers = semantic3WorkerCount(modules);
+#if LDC_POSIX
+  if (semantic3Workers > 1) {
+    if (!runSemantic3Workers(modules, semantic3Workers, doSemantic3,
+                             emitModules)) {
+      fatal();
+    }
+  } else
+#endif
+  {
+    for (unsigned i = 0; i < modules.dim; i++)
+      doSemantic3(modules[i]);
+    for (unsigned i = 0; i < cpp::Module::amodules.dim; i++)
+      doSemantic3(cpp::Module::amodules[i]); // CALYPSO
+    if (global.errors) {
+      fatal();
+    }
+
+    {
+      TimeTraceScope timeScope("Deferred semantic3");
+      Module::runDeferredSemantic3();
+    }
+    memoryReportPhaseDone("semantic3");
   }
 
-  Module::runDeferredSemantic3();
+  if (global.params.verbose && CtfeArena::peakMemory) {
+    fprintf(global.stdmsg, "ctfe      peak memory %llu KB\n",
+            static_cast<unsigned long long>(CtfeArena::peakMemory / 1024));
+  }
+  if (global.params.verbose && TemplateInstanceTable::numLookups) {
+    fprintf(global.stdmsg,
+            "templates lookups %llu, probes %llu, hash collisions %llu\n",
+            TemplateInstanceTable::numLookups, TemplateInstanceTable::numProbes,
+            TemplateInstanceTable::numCollisions);
+  }
 
   // CALYPSO HACK __cpp modules need to be codegen'd too, and we only know which
   // are required after DeclReferencer has completed its task.
+  bool const partitionCppModules = cppPartitions && !singleObj;
   for (auto m: cpp::Module::amodules) {
     m->buildTargetFiles(singleObj, createSharedLib || createStaticLib);
-    modules.push(m);
+    if (!partitionCppModules) {
+      modules.push(m);
+    }
   }
 
   if (global.errors || global.warnings) {
@@ -1298,31 +1620,25 @@ int main(int argc, char **argv) {
     deps.write();
   }
 
-  // Generate one or more object/IR/bitcode files.
   if (global.params.obj && !modules.empty()) {
-    ldc::CodeGenerator cg(getGlobalContext(), singleObj);
-
-    for (unsigned i = 0; i < modules.dim; i++) {
-      Module *const m = modules[i];
-      if (global.params.verbose) {
-        fprintf(global.stdmsg, "code      %s\n", m->toChars());
-      }
-
-      auto lp = m->langPlugin();
-      if (lp && !singleObj && !lp->needsCodegen(m)) { // CALYPSO UGLY?
-          global.params.objfiles->push(m->objfile->name->str);
-          continue;
+    if (semantic3Workers > 1) {
+      // Already emitted by the workers
+      for (unsigned i = 0; i < modules.dim; i++) {
+        global.params.objfiles->push(modules[i]->objfile->name->str);
       }
-
-      m->deleteObjFile(); // CALYPSO
-      cg.emit(m);
-
-      if (global.errors) {
-        fatal();
+    } else {
+      emitModules(modules);
+      if (partitionCppModules) {
+        emitCppPartitions(modules[0]->objfile->name->str);
       }
     }
   }
 
+  memoryReportPhaseDone("codegen");
+
+  // CALYPSO save the C++ instantiations done by DMD during this compilation
+  cpp::calypso.pch.save();
+
   // Generate DDoc output files.
   if (global.params.doDocComments) {
     for (unsigned i = 0; i < modules.dim; i++) {
@@ -1352,11 +1668,15 @@ int main(int argc, char **argv) {
       error(Loc(), "no object files");
     }
   } else {
-    if (global.params.link) {
-      status = linkObjToBinary(createSharedLib, staticFlag);
-    } else if (createStaticLib) {
-      status = createStaticLibrary();
+    {
+      TimeTraceScope timeScope("Link");
+      if (global.params.link) {
+        status = linkObjToBinary(createSharedLib, staticFlag);
+      } else if (createStaticLib) {
+        status = createStaticLibrary();
+      }
     }
+    memoryReportPhaseDone("link");
 
     if (global.params.run && status == EXIT_SUCCESS) {
       status = runExecutable();
@@ -1369,5 +1689,10 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (opts::timeTrace) {
+    writeTimeTrace(timeTraceFilename(modules));
+  }
+  writeMemoryReport(opts::memoryReport, opts::memoryReportFile);
+
   return status;
 }
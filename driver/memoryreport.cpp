@@ -0,0 +1,184 @@
+//===-- memoryreport.cpp --------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "driver/memoryreport.h"
+#include "cpp/calypso.h"
+#include "expression.h"
+#include "ctfe.h"
+#include "errors.h"
+#include "mars.h"
+#include "rmem.h"
+#include "template.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+#if _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+struct Phase {
+  const char *name;
+  size_t heap; // heap in use at the end of the phase, see heapUsage()
+};
+
+bool enabled = false;
+std::vector<Phase> phases;
+cpp::LangPlugin::ClangMemoryUsage clangUsage;
+
+const char *const memKindNames[MEMmax] = {
+    "Dsymbol", "Type", "Expression", "Statement", "Initializer", "CTFE"};
+
+size_t peakResidentSetSize() {
+#if _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#if __APPLE__
+  return usage.ru_maxrss; // in bytes
+#else
+  return static_cast<size_t>(usage.ru_maxrss) * 1024; // in kilobytes
+#endif
+#endif
+}
+
+// GetMallocUsage() relies on mallinfo() with glibc, whose int fields wrap
+// past 2 GB. Use mallinfo2() when glibc has it, or else the resident set.
+size_t heapUsage() {
+#if defined(__GLIBC__) &&                                                      \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#elif defined(__linux__)
+  unsigned long long size, resident;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm)
+    return 0;
+  int n = fscanf(statm, "%llu %llu", &size, &resident);
+  fclose(statm);
+  if (n != 2)
+    return 0;
+  return static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE);
+#else
+  return llvm::sys::Process::GetMallocUsage();
+#endif
+}
+
+unsigned long long kb(size_t bytes) { return (bytes + 1023) / 1024; }
+
+void printText(size_t peak) {
+  FILE *out = global.stdmsg;
+  fprintf(out, "memory    peak resident set %llu KB\n", kb(peak));
+
+  size_t previous = 0;
+  for (auto &phase : phases) {
+    long long growth = static_cast<long long>(phase.heap) -
+                       static_cast<long long>(previous);
+    fprintf(out, "memory    %-12s heap %llu KB (%+lld KB)\n", phase.name,
+            kb(phase.heap), growth / 1024);
+    previous = phase.heap;
+  }
+
+  for (int i = 0; i < MEMmax; i++) {
+    fprintf(out, "memory    %-12s %llu nodes, %llu KB\n", memKindNames[i],
+            static_cast<unsigned long long>(memAccounts[i].count),
+            kb(memAccounts[i].bytes));
+  }
+  fprintf(out, "memory    CTFE arenas peak %llu KB\n",
+          kb(CtfeArena::peakMemory));
+  fprintf(out, "memory    templates    %llu instances, %llu KB\n",
+          static_cast<unsigned long long>(TemplateInstance::numInstances),
+          kb(TemplateInstance::instantiationMemory));
+  fprintf(out,
+          "memory    Clang        AST %llu KB, side tables %llu KB, source "
+          "manager %llu KB, preprocessor %llu KB\n",
+          kb(clangUsage.ast), kb(clangUsage.sideTables),
+          kb(clangUsage.sourceManager), kb(clangUsage.preprocessor));
+}
+
+void printJson(llvm::raw_ostream &os, size_t peak) {
+  os << "{\n  \"peakResidentBytes\": " << peak << ",\n";
+
+  os << "  \"phases\": [";
+  size_t previous = 0;
+  for (size_t i = 0; i < phases.size(); i++) {
+    os << (i ? ",\n" : "\n") << "    {\"name\": \"" << phases[i].name
+       << "\", \"heapBytes\": " << phases[i].heap << ", \"growthBytes\": "
+       << static_cast<long long>(phases[i].heap) -
+              static_cast<long long>(previous)
+       << "}";
+    previous = phases[i].heap;
+  }
+  os << "\n  ],\n";
+
+  os << "  \"frontend\": {";
+  for (int i = 0; i < MEMmax; i++) {
+    os << (i ? ",\n" : "\n") << "    \"" << memKindNames[i]
+       << "\": {\"count\": " << memAccounts[i].count
+       << ", \"bytes\": " << memAccounts[i].bytes << "}";
+  }
+  os << "\n  },\n";
+
+  os << "  \"ctfeArenaPeakBytes\": " << CtfeArena::peakMemory << ",\n";
+  os << "  \"templateInstances\": {\"count\": "
+     << TemplateInstance::numInstances
+     << ", \"bytes\": " << TemplateInstance::instantiationMemory << "},\n";
+  os << "  \"clang\": {\"astBytes\": " << clangUsage.ast
+     << ", \"sideTableBytes\": " << clangUsage.sideTables
+     << ", \"sourceManagerBytes\": " << clangUsage.sourceManager
+     << ", \"preprocessorBytes\": " << clangUsage.preprocessor << "}\n";
+  os << "}\n";
+}
+
+} // anonymous namespace
+
+void initializeMemoryReport() { enabled = true; }
+
+void memoryReportPhaseDone(const char *phase) {
+  if (!enabled)
+    return;
+  phases.push_back({phase, heapUsage()});
+
+  // The Clang AST only grows, keep its latest size
+  clangUsage = cpp::calypso.getClangMemoryUsage();
+}
+
+void writeMemoryReport(bool text, const std::string &jsonFilename) {
+  if (!enabled)
+    return;
+
+  size_t peak = peakResidentSetSize();
+  if (text)
+    printText(peak);
+
+  if (!jsonFilename.empty()) {
+    std::error_code errinfo;
+    llvm::raw_fd_ostream os(jsonFilename, errinfo, llvm::sys::fs::F_Text);
+    if (errinfo) {
+      error(Loc(), "cannot write memory report '%s': %s", jsonFilename.c_str(),
+            errinfo.message().c_str());
+    } else {
+      printJson(os, peak);
+    }
+  }
+}
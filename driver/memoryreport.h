@@ -0,0 +1,30 @@
+//===-- driver/memoryreport.h - Memory usage report -------------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reports the peak memory of the compiler, the heap growth of each phase and
+// the memory used by the frontend AST per node category, CTFE, template instances
+// and Clang (-memory-report).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_DRIVER_MEMORYREPORT_H
+#define LDC_DRIVER_MEMORYREPORT_H
+
+#include <string>
+
+void initializeMemoryReport();
+
+/// Takes a snapshot of the heap at the end of a phase of the compilation.
+void memoryReportPhaseDone(const char *phase);
+
+/// Prints the report to global.stdmsg if text is set, and writes it as JSON
+/// to jsonFilename if it isn't empty.
+void writeMemoryReport(bool text, const std::string &jsonFilename);
+
+#endif
@@ -8,12 +8,16 @@
 //===----------------------------------------------------------------------===//
 
 #include "driver/toobj.h"
+#include "driver/cl_options.h"
+#include "driver/ir2obj_cache.h"
+#include "driver/linker.h"
 #include "driver/targetmachine.h"
 #include "driver/tool.h"
 #include "gen/irstate.h"
 #include "gen/logger.h"
 #include "gen/optimizer.h"
 #include "gen/programs.h"
+#include "gen/timetrace.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Bitcode/ReaderWriter.h"
@@ -37,6 +41,23 @@
 #include "llvm/Target/TargetSubtargetInfo.h"
 #endif
 #include "llvm/IR/Module.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#if LDC_LLVM_VER >= 309
+#include "llvm/MC/MCAsmBackend.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
+#include "llvm/MC/MCParser/MCTargetAsmParser.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetRegistry.h"
+#endif
 #include <cstddef>
 #include <fstream>
 
@@ -46,8 +67,13 @@ static llvm::cl::opt<bool>
 
 // based on llc code, University of Illinois Open Source License
 static void codegenModule(llvm::TargetMachine &Target, llvm::Module &m,
+#if LDC_LLVM_VER >= 307
+                          llvm::raw_pwrite_stream &out,
+#else
                           llvm::raw_fd_ostream &out,
+#endif
                           llvm::TargetMachine::CodeGenFileType fileType) {
+  TimeTraceScope timeScope("Machine codegen");
   using namespace llvm;
 
 // Create a PassManager to hold and optimize the collection of passes we are
@@ -153,6 +179,83 @@ static void assemble(const std::string &asmpath, const std::string &objpath) {
   }
 }
 
+#if LDC_LLVM_VER >= 309
+// Assembles the output of codegenModule() with the MC layer, like clang's
+// cc1as does. Much cheaper than running the backend a second time for the
+// object file when both assembly and object outputs are requested.
+static bool assembleInProcess(llvm::TargetMachine &Target,
+                              const std::string &asmpath,
+                              const std::string &objpath) {
+  using namespace llvm;
+
+  const llvm::Target &T = Target.getTarget();
+  const Triple &TT = Target.getTargetTriple();
+  StringRef CPU = Target.getTargetCPU();
+
+  auto Buffer = MemoryBuffer::getFile(asmpath);
+  if (!Buffer) {
+    return false;
+  }
+  SourceMgr SrcMgr;
+  SrcMgr.AddNewSourceBuffer(std::move(*Buffer), SMLoc());
+
+  std::unique_ptr<MCRegisterInfo> MRI(T.createMCRegInfo(TT.str()));
+  std::unique_ptr<MCAsmInfo> MAI(T.createMCAsmInfo(*MRI, TT.str()));
+  std::unique_ptr<MCInstrInfo> MCII(T.createMCInstrInfo());
+  std::unique_ptr<MCSubtargetInfo> STI(T.createMCSubtargetInfo(
+      TT.str(), CPU, Target.getTargetFeatureString()));
+  if (!MRI || !MAI || !MCII || !STI) {
+    return false;
+  }
+
+  MCObjectFileInfo MOFI;
+  MCContext Ctx(MAI.get(), MRI.get(), &MOFI, &SrcMgr);
+  MOFI.InitMCObjectFileInfo(TT, Target.getRelocationModel() == Reloc::PIC_,
+                            Target.getCodeModel(), Ctx);
+
+  std::error_code errinfo;
+  raw_fd_ostream out(objpath, errinfo, sys::fs::F_None);
+  if (errinfo) {
+    return false;
+  }
+
+  MCCodeEmitter *CE = T.createMCCodeEmitter(*MCII, *MRI, Ctx);
+  MCAsmBackend *MAB = T.createMCAsmBackend(*MRI, TT.str(), CPU);
+  if (!CE || !MAB) {
+    return false;
+  }
+  std::unique_ptr<MCStreamer> Str(T.createMCObjectStreamer(
+      TT, Ctx, *MAB, out, CE, *STI, Target.Options.MCOptions.MCRelaxAll,
+      Target.Options.MCOptions.MCIncrementalLinkerCompatible,
+      /*DWARFMustBeAtTheEnd*/ true));
+
+  std::unique_ptr<MCAsmParser> Parser(
+      createMCAsmParser(SrcMgr, Ctx, *Str, *MAI));
+  std::unique_ptr<MCTargetAsmParser> TAP(
+      T.createMCAsmParser(*STI, *Parser, *MCII, Target.Options.MCOptions));
+  if (!TAP) {
+    return false;
+  }
+  Parser->setTargetParser(*TAP);
+
+  return !Parser->Run(/*NoInitialTextSection*/ false);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+static llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> inMemoryObjects;
+
+std::unique_ptr<llvm::MemoryBuffer> takeInMemoryObject(llvm::StringRef filename) {
+  auto it = inMemoryObjects.find(filename);
+  if (it == inMemoryObjects.end()) {
+    return nullptr;
+  }
+  auto buffer = std::move(it->second);
+  inMemoryObjects.erase(it);
+  return buffer;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace {
@@ -335,8 +438,7 @@ public:
 } // end of anonymous namespace
 
 void writeModule(llvm::Module *m, std::string filename) {
-  // run optimizer
-  ldc_optimize_module(m);
+  TimeTraceScope timeScope("Backend", filename);
 
   // There is no integrated assembler on AIX because XCOFF is not supported.
   // Starting with LLVM 3.5 the integrated assembler can be used with MinGW.
@@ -345,6 +447,38 @@ void writeModule(llvm::Module *m, std::string filename) {
       (NoIntegratedAssembler ||
        global.params.targetTriple.getOS() == llvm::Triple::AIX);
 
+  // When both assembly and object files are requested, run the backend once
+  // and assemble its output.
+  bool const assembleAsmOutput =
+#if LDC_LLVM_VER >= 309
+      global.params.output_s && global.params.output_o && !assembleExternally;
+#else
+      false;
+#endif
+
+  // With -lib the object file may only be needed by the internal archiver.
+  bool const objectInMemory = opts::inMemoryObjects && opts::createStaticLib &&
+                              useInternalArchiver() && global.params.output_o &&
+                              !assembleExternally && !assembleAsmOutput;
+
+  // Use the cached object file if the unoptimized module is unchanged. Only
+  // object files are cached, other outputs need the optimized module anyway.
+  bool const useIR2ObjCache =
+      !opts::ir2objCacheDir.empty() && global.params.output_o &&
+      !global.params.output_bc && !global.params.output_ll &&
+      !global.params.output_s && !assembleExternally && !objectInMemory;
+  llvm::SmallString<32> moduleHash;
+  if (useIR2ObjCache) {
+    ir2obj::calculateModuleHash(m, moduleHash);
+    if (!ir2obj::cacheLookup(moduleHash).empty() &&
+        ir2obj::recoverObjectFile(moduleHash, filename)) {
+      return;
+    }
+  }
+
+  // run optimizer
+  ldc_optimize_module(m);
+
   // eventually do our own path stuff, dmd's is a bit strange.
   using LLPath = llvm::SmallString<128>;
 
@@ -416,13 +550,33 @@ void writeModule(llvm::Module *m, std::string filename) {
     if (assembleExternally) {
       assemble(spath.str(), filename);
     }
+#if LDC_LLVM_VER >= 309
+    if (assembleAsmOutput) {
+      Logger::println("Assembling object file to: %s\n", filename.c_str());
+      if (!assembleInProcess(*gTargetMachine, spath.str(), filename)) {
+        error(Loc(), "cannot assemble object file '%s'", filename.c_str());
+        fatal();
+      }
+    }
+#endif
 
     if (!global.params.output_s) {
       llvm::sys::fs::remove(spath.str());
     }
   }
 
-  if (global.params.output_o && !assembleExternally) {
+  if (objectInMemory) {
+    Logger::println("Writing object file to memory: %s\n", filename.c_str());
+    llvm::SmallVector<char, 0> buffer;
+    {
+      llvm::raw_svector_ostream out(buffer);
+      codegenModule(*gTargetMachine, *m, out,
+                    llvm::TargetMachine::CGFT_ObjectFile);
+    }
+    inMemoryObjects[filename] = llvm::MemoryBuffer::getMemBufferCopy(
+        llvm::StringRef(buffer.data(), buffer.size()), filename);
+  } else if (global.params.output_o && !assembleExternally &&
+             !assembleAsmOutput) {
     Logger::println("Writing object file to: %s\n", filename.c_str());
     ErrorInfo errinfo;
     {
@@ -441,6 +595,10 @@ void writeModule(llvm::Module *m, std::string filename) {
         fatal();
       }
     }
+
+    if (useIR2ObjCache) {
+      ir2obj::cacheObjectFile(filename, moduleHash);
+    }
   }
 
 #undef ERRORINFO_STRING
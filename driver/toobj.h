@@ -14,12 +14,19 @@
 #ifndef LDC_DRIVER_TOOBJ_H
 #define LDC_DRIVER_TOOBJ_H
 
+#include <memory>
 #include <string>
 
 namespace llvm {
+class MemoryBuffer;
 class Module;
+class StringRef;
 }
 
 void writeModule(llvm::Module *m, std::string filename);
 
+/// Returns the object file that writeModule() kept in memory instead of
+/// writing it to filename (-lib-in-memory), or null if it's on disk.
+std::unique_ptr<llvm::MemoryBuffer> takeInMemoryObject(llvm::StringRef filename);
+
 #endif
@@ -22,7 +22,9 @@
 #include "gen/irstate.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/metadata.h"
 #include "gen/nested.h"
+#include "gen/optimizer.h"
 #include "gen/rttibuilder.h"
 #include "gen/runtime.h"
 #include "gen/structs.h"
@@ -30,6 +32,7 @@
 #include "ir/iraggr.h"
 #include "ir/irfunction.h"
 #include "ir/irtypeclass.h"
+#include "llvm/ADT/SmallString.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -138,8 +141,12 @@ DValue *DtoNewClass(Loc &loc, TypeClass *tc, NewExp *newexp) {
   // allocate
   LLValue *mem;
   if (newexp->onstack) {
-    // FIXME align scope class to its largest member
-    mem = DtoRawAlloca(DtoType(tc)->getContainedType(0), 0, ".newclass_alloca");
+    // CALYPSO align overaligned scope classes to their largest member, which
+    // mostly happens for classes inheriting from C++ records (SIMD types..)
+    unsigned alignment =
+        tc->sym->alignsize > Target::ptrsize ? tc->sym->alignsize : 0;
+    mem = DtoRawAlloca(DtoType(tc)->getContainedType(0), alignment,
+                       ".newclass_alloca");
   }
   // custom allocator
   else if (newexp->allocator) {
@@ -510,6 +517,20 @@ LLValue *DtoVirtualFunctionPointer(DValue *inst, FuncDeclaration *fdecl,
   // load funcptr
   funcval = DtoAlignedLoad(funcval);
 
+  // tell the devirtualization pass which slot of which class this is
+  ClassDeclaration *cd =
+      static_cast<TypeClass *>(inst->getType()->toBasetype())->sym;
+  auto load = llvm::dyn_cast<llvm::LoadInst>(funcval);
+  if (load && opts::devirtualize != opts::NoDevirtualization &&
+      DtoIsDevirtualizable(cd)) {
+    llvm::Metadata *mdVals[] = {
+        llvm::MDString::get(gIR->context(),
+                            getIrAggr(cd)->getVtblSymbol()->getName()),
+        llvm::ConstantAsMetadata::get(DtoConstUint(fdecl->vtblIndex))};
+    load->setMetadata(VCALL_METADATA,
+                      llvm::MDNode::get(gIR->context(), mdVals));
+  }
+
   IF_LOG Logger::cout() << "funcval: " << *funcval << '\n';
 
   // cast to final funcptr type
@@ -525,6 +546,35 @@ LLValue *DtoVirtualFunctionPointer(DValue *inst, FuncDeclaration *fdecl,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+bool DtoIsDevirtualizable(ClassDeclaration *cd) {
+  for (; cd; cd = cd->baseClass) {
+    if (cd->isInterfaceDeclaration() || cd->isCPPclass() || cd->langPlugin()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DtoAddVtblMetadata(ClassDeclaration *cd) {
+  assert(DtoIsDevirtualizable(cd));
+
+  llvm::StringRef baseVtbl;
+  if (cd->baseClass) {
+    baseVtbl = getIrAggr(cd->baseClass)->getVtblSymbol()->getName();
+  }
+
+  llvm::Metadata *mdVals[VD_NumFields];
+  mdVals[VD_BaseVtbl] = llvm::MDString::get(gIR->context(), baseVtbl);
+
+  llvm::SmallString<64> name;
+  llvm::NamedMDNode *node = gIR->module.getOrInsertNamedMetadata(
+      llvm::Twine(VD_PREFIX, getIrAggr(cd)->getVtblSymbol()->getName())
+          .toStringRef(name));
+  node->addOperand(llvm::MDNode::get(gIR->context(), mdVals));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 #if GENERATE_OFFTI
 
 // build a single element for the OffsetInfo[] of ClassInfo
@@ -60,4 +60,11 @@ DValue *DtoDynamicCastInterface(Loc &loc, DValue *val, Type *to);
 llvm::Value *DtoVirtualFunctionPointer(DValue *inst, FuncDeclaration *fdecl,
                                        char *name);
 
+/// Whether the virtual calls on cd may be devirtualized by -d-devirtualize, i.e.
+/// whether it's a D class with only D classes as bases.
+bool DtoIsDevirtualizable(ClassDeclaration *cd);
+
+/// Emits the vtable metadata of cd read by the devirtualization pass.
+void DtoAddVtblMetadata(ClassDeclaration *cd);
+
 #endif
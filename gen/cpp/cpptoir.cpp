@@ -6,10 +6,12 @@
 
 #include "mtype.h"
 #include "target.h"
+#include "driver/cl_options.h"
 #include "gen/dvalue.h"
 #include "gen/functions.h"
 #include "gen/logger.h"
 #include "gen/irstate.h"
+#include "gen/optimizer.h"
 #include "gen/classes.h"
 #include "ir/irfunction.h"
 #include "gen/llvmhelpers.h"
@@ -34,10 +36,12 @@
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/Lookup.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <algorithm>
 #include <memory>
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -57,14 +61,21 @@ void LangPlugin::enterModule(::Module *, llvm::Module *lm)
     if (!AST)
         return;
 
-    pch.save(); // save the numerous instantiations done by DMD back into the PCH
-
     auto& Context = getASTContext();
 
     auto Opts = new clang::CodeGenOptions;
     if (global.params.symdebug)
         Opts->setDebugInfo(clang::codegenoptions::FullDebugInfo);
 
+    // Emit the C++ code like clang++ would at the same optimization level, e.g TBAA metadata is only emitted when optimizing.
+    // NOTE: -fstrict-vtable-pointers isn't enabled since D classes deriving from C++ ones set the vptr themselves.
+    Opts->OptimizationLevel = optLevel();
+    Opts->OptimizeSize = sizeLevel();
+    Opts->StructPathTBAA = true;
+    Opts->setInlining(willInline() ? clang::CodeGenOptions::NormalInlining
+                                   : clang::CodeGenOptions::OnlyAlwaysInlining);
+    Opts->DisableFPElim = opts::disableFpElim;
+
     CGM.reset(new clangCG::CodeGenModule(Context,
                             AST->getPreprocessor().getHeaderSearchInfo().getHeaderSearchOpts(),
                             AST->getPreprocessor().getPreprocessorOpts(),
@@ -117,6 +128,65 @@ void removeDuplicateModuleFlags(llvm::Module *lm)
     }
 }
 
+// The functions defined by Clang are the ones it mangled a declaration for, plus the internal helpers
+// running the initializers and destructors of C++ globals. The D functions of the module must be left alone.
+static bool isClangEmitted(clangCG::CodeGenModule& CGM, llvm::Function& F)
+{
+    clang::GlobalDecl GD;
+    if (CGM.lookupRepresentativeDecl(F.getName(), GD))
+        return true;
+
+    auto Name = F.getName();
+    return F.hasInternalLinkage() &&
+        (Name.startswith("__cxx_global_") || Name.startswith("_GLOBAL__sub_I_") || Name.startswith("__dtor_"));
+}
+
+// Clang set the target attributes of the C++ functions from the target options the PCH was generated with,
+// remove them so that the C++ functions get compiled for the target of LDC like the D ones,
+// and add the sanitizer attributes LDC gives to D functions.
+static void adjustFunctionAttributes(clangCG::CodeGenModule& CGM, clang::ASTContext& Context, llvm::Module *lm)
+{
+    auto& TargetOpts = Context.getTargetInfo().getTargetOpts();
+    auto Features = TargetOpts.Features;
+    std::sort(Features.begin(), Features.end()); // like CodeGenModule::ConstructAttributeList
+    auto DefaultFeatures = llvm::join(Features.begin(), Features.end(), ",");
+
+    // Clang omits the attributes with an empty value
+    auto isClangDefault = [] (llvm::Function& F, const char *Kind, llvm::StringRef Value) {
+        if (!F.hasFnAttribute(Kind))
+            return Value.empty();
+        return F.getFnAttribute(Kind).getValueAsString() == Value;
+    };
+
+    for (auto& F: *lm)
+    {
+        if (F.isDeclaration() || !isClangEmitted(CGM, F))
+            continue;
+
+        if (isClangDefault(F, "target-cpu", TargetOpts.CPU) &&
+                isClangDefault(F, "target-features", DefaultFeatures))
+        {
+            F.removeFnAttr("target-cpu");
+            F.removeFnAttr("target-features");
+        }
+
+        switch (opts::sanitize)
+        {
+            case opts::AddressSanitizer:
+                F.addFnAttr(llvm::Attribute::SanitizeAddress);
+                break;
+            case opts::MemorySanitizer:
+                F.addFnAttr(llvm::Attribute::SanitizeMemory);
+                break;
+            case opts::ThreadSanitizer:
+                F.addFnAttr(llvm::Attribute::SanitizeThread);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
 void LangPlugin::leaveModule(::Module *m, llvm::Module *lm)
 {
     if (!getASTUnit())
@@ -130,8 +200,20 @@ void LangPlugin::leaveModule(::Module *m, llvm::Module *lm)
     if (ldcCtor) ldcCtor->setName("llvm.global_ctors__d");
     if (ldcDtor) ldcDtor->setName("llvm.global_dtors__d");
 
+    if (partition >= 0 && partition == (int)numPartitions - 1)
+        emitForeignInstances();
+
     CGM->Release();
 
+    // The other objects reference the template instances owned by this one, which Clang emitted as linkonce_odr
+    for (auto& Name: ownedInstances)
+        if (auto F = lm->getFunction(Name))
+            if (F->hasLinkOnceODRLinkage())
+                F->setLinkage(llvm::GlobalValue::WeakODRLinkage);
+    ownedInstances.clear();
+
+    adjustFunctionAttributes(*CGM, getASTContext(), lm);
+
     // Then swap them back and append the Clang global structors to the LDC ones.
     // NOTE: the Clang created ones have a slightly different struct type, with an additional "key" that may be null or used for COMDAT stuff
     auto clangCtor = lm->getNamedGlobal("llvm.global_ctors"),
@@ -180,7 +262,7 @@ void LangPlugin::leaveModule(::Module *m, llvm::Module *lm)
     CGM->getTypes().swapTypeCache(CGRecordLayouts, RecordDeclTypes, TypeCache); // save the CodeGenTypes state
     CGM.reset();
 
-    if (!global.errors && isCPP(m))
+    if (!global.errors && isCPP(m) && !opts::cppPartitions)
         calypso.genModSet.add(m);
 }
 
@@ -537,7 +619,13 @@ bool LangPlugin::toIsReturnInArg(CallExp* ce)
     auto& fnInfo = CGM->getTypes().arrangeFunctionDeclaration(FD);
     auto& RetAI = fnInfo.getReturnInfo();
 
-    return RetAI.isIndirect() || RetAI.isInAlloca();
+    if (RetAI.isIndirect() || RetAI.isInAlloca())
+        return true;
+
+    // Records returned in registers are also constructed in place, EmitCall then
+    // stores the registers straight into the variable instead of a temporary that
+    // would get copied afterwards.
+    return FD->getReturnType()->isRecordType() && !RetAI.isIgnore();
 }
 
 LLValue *LangPlugin::toVirtualFunctionPointer(DValue* inst, 
@@ -634,6 +722,7 @@ DValue* LangPlugin::toCallFunction(Loc& loc, Type* resulttype, DValue* fnval,
 //             CGF()->EmitAggregateCopy(tmp, L.getAddress(), type, /*IsVolatile*/false,
 //                                 L.getAlignment());
 //             Args.add(clangCG::RValue::getAggregate(tmp), type);
+            // NOTE: unlike returns, records passed by value still go through the D temporary holding the argument
             clangCG::Address addr(argval->getRVal(), CGF()->getNaturalTypeAlignment(ArgTy));
             Args.add(clangCG::RValue::getAggregate(addr),
                      ArgTy, /*NeedsCopy*/ false);
@@ -751,8 +840,43 @@ void LangPlugin::toDefineFunction(::FuncDeclaration* fdecl)
     auto FD = getFD(fdecl);
     const clang::FunctionDecl *Def;
 
-    if (FD->hasBody(Def) && getIrFunc(fdecl)->func->isDeclaration())
-        EmitFunctionDecl(*CGM, const_cast<clang::FunctionDecl*>(Def)); // TODO remove const_cast
+    auto Func = getIrFunc(fdecl)->func;
+    if (!FD->hasBody(Def) || !Func->isDeclaration())
+        return;
+
+    if (partition >= 0 && Def->isTemplateInstantiation())
+    {
+        auto Name = Func->getName();
+        if (llvm::HashString(Name) % numPartitions != (unsigned)partition)
+        {
+            foreignInstances[Name] = Def; // owned by another partition
+            return;
+        }
+        definedInstances.insert(Name);
+        ownedInstances.push_back(Name);
+    }
+
+    EmitFunctionDecl(*CGM, const_cast<clang::FunctionDecl*>(Def)); // TODO remove const_cast
+}
+
+// Emits into the last partition the instances that their owner didn't reference
+void LangPlugin::emitForeignInstances()
+{
+    for (auto& I: foreignInstances)
+    {
+        if (definedInstances.count(I.first))
+            continue;
+
+        auto Func = ResolvedFunc::get(*CGM, I.second).Func;
+        if (!Func || !Func->isDeclaration())
+            continue;
+
+        EmitFunctionDecl(*CGM, const_cast<clang::FunctionDecl*>(I.second));
+        ownedInstances.push_back(I.first);
+    }
+
+    foreignInstances.clear();
+    definedInstances.clear();
 }
 
 void LangPlugin::addBaseClassData(AggrTypeBuilder &b, ::AggregateDeclaration *base)
@@ -23,6 +23,7 @@
 #include "gen/llvm.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/optimizer.h"
 #include "gen/tollvm.h"
 #include "gen/uda.h"
 #include "ir/irtype.h"
@@ -275,6 +276,11 @@ public:
       llvm::GlobalVariable *vtbl = ir->getVtblSymbol();
       vtbl->setInitializer(ir->getVtblInit());
       setLinkage(lwc, vtbl);
+
+      if (opts::devirtualize != opts::NoDevirtualization &&
+          DtoIsDevirtualizable(decl)) {
+        DtoAddVtblMetadata(decl);
+      }
       }
 
       llvm::GlobalVariable *classZ = ir->getClassInfoSymbol();
@@ -13,6 +13,7 @@
 #include "gen/llvm.h"
 #include "gen/llvmhelpers.h"
 #include "gen/logger.h"
+#include "gen/tbaa.h"
 #include "gen/tollvm.h"
 
 namespace {
@@ -84,6 +85,9 @@ LLValue *DVarValue::getRVal() {
   }
 
   llvm::Value *rawValue = DtoLoad(storage);
+  if (!mayAlias) {
+    DtoSetTBAA(llvm::cast<llvm::Instruction>(rawValue), type);
+  }
 
   if (type->toBasetype()->ty == Tbool) {
     assert(rawValue->getType() == llvm::Type::getInt8Ty(gIR->context()));
@@ -147,6 +147,9 @@ public:
 
   DVarValue *isVar() override { return this; }
 
+  /// Set for overlapping fields, whose loads and stores get no TBAA tag.
+  bool mayAlias = false;
+
 protected:
   llvm::Value *const val;
   bool const isSpecialRefVar;
@@ -20,6 +20,7 @@
 #include "template.h"
 #include "gen/abi.h"
 #include "gen/arrays.h"
+#include "gen/cl_helpers.h"
 #include "gen/classes.h"
 #include "gen/dvalue.h"
 #include "gen/cgforeign.h"
@@ -41,6 +42,46 @@
 #include "llvm/IR/CFG.h"
 #include <iostream>
 
+static llvm::cl::opt<llvm::cl::boolOrDefault, false,
+                     opts::FlagParser<llvm::cl::boolOrDefault>>
+    nothrowNounwind(
+        "nothrow-nounwind",
+        llvm::cl::desc("Mark nothrow functions nounwind, assuming that the "
+                       "Errors they may throw aren't caught (default when "
+                       "asserts are disabled)"),
+        llvm::cl::ZeroOrMore);
+
+static bool isNothrowNounwind() {
+  return nothrowNounwind == llvm::cl::BOU_TRUE ||
+         (nothrowNounwind == llvm::cl::BOU_UNSET && !global.params.useAssert);
+}
+
+/// Pointers and references to immutable data get readonly.
+/// scope doesn't imply nocapture, as the frontend doesn't check it.
+static void applyStorageClassAttrs(IrFuncTyArg &arg, Parameter *param) {
+  if (!arg.ltype->isPointerTy() || arg.rewrite || arg.isByVal()) {
+    return;
+  }
+
+  Type *t = param->type->toBasetype();
+  Type *pointee = t;
+  if (arg.byref) {
+    if (!(param->storageClass & STCref)) {
+      return;
+    }
+  } else if (t->ty == Tpointer) {
+    pointee = t->nextOf()->toBasetype();
+  } else if (t->ty != Tclass) {
+    return;
+  }
+
+  // C++ types may have mutable fields
+  Dsymbol *sym = pointee->toDsymbol(nullptr);
+  if (pointee->isImmutable() && !(sym && sym->langPlugin())) {
+    arg.attrs.add(LLAttribute::ReadOnly);
+  }
+}
+
 llvm::FunctionType *DtoFunctionType(Type *type, IrFuncTy &irFty, Type *thistype,
                                     Type *nesttype, bool isMain, bool isCtor,
                                     bool isIntrinsic) {
@@ -179,6 +220,16 @@ llvm::FunctionType *DtoFunctionType(Type *type, IrFuncTy &irFty, Type *thistype,
   // let the ABI rewrite the types as necessary
   abi->rewriteFunctionType(f, newIrFty);
 
+  // C++ const isn't transitive, and Calypso lowers C++ references to scope
+  // ref parameters which may well be captured.
+  if (!isMain && f->linkage != LINKcpp) {
+    for (auto arg : newIrFty.args) {
+      applyStorageClassAttrs(*arg,
+                             Parameter::getNth(f->parameters,
+                                               arg->parametersIdx));
+    }
+  }
+
   // Now we can modify irFty safely.
   irFty = llvm_move(newIrFty);
 
@@ -224,6 +275,46 @@ llvm::FunctionType *DtoFunctionType(Type *type, IrFuncTy &irFty, Type *thistype,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+AttrBuilder DtoFunctionAttributes(TypeFunction *f, IrFuncTy &irFty,
+                                  FuncDeclaration *fdecl) {
+  AttrBuilder attrs;
+  if (!f->isnothrow) {
+    return attrs;
+  }
+
+  if (isNothrowNounwind()) {
+    attrs.add(LLAttribute::NoUnwind);
+  }
+
+  if (f->linkage == LINKcpp) {
+    return attrs;
+  }
+
+  // The purity of delegates depends on their unknown context, and
+  // constructors write to their this even if it's immutable.
+  PURE purity = PUREweak;
+  if (fdecl) {
+    if (!fdecl->isCtorDeclaration() && !fdecl->isPostBlitDeclaration() &&
+        !fdecl->isDtorDeclaration()) {
+      purity = fdecl->isPure();
+    }
+  } else if (!irFty.arg_this && !irFty.arg_nest) {
+    f->purityLevel();
+    purity = f->purity;
+  }
+
+  // Const and strongly pure functions only write to memory they allocated
+  // themselves, which the caller can't see unless the result points to it.
+  if (purity >= PUREconst && !f->isref && !f->varargs && !irFty.arg_sret &&
+      !f->next->hasPointers()) {
+    attrs.add(LLAttribute::ReadOnly);
+  }
+
+  return attrs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 static llvm::FunctionType *DtoVaFunctionType(FuncDeclaration *fdecl) {
   IrFuncTy &irFty = getIrFunc(fdecl, true)->irFty;
   if (irFty.funcType) {
@@ -491,6 +582,10 @@ void DtoDeclareFunction(FuncDeclaration *fdecl) {
   // parameter attributes
   if (!DtoIsIntrinsic(fdecl)) {
     applyParamAttrsToLLFunc(f, getIrFunc(fdecl)->irFty, func);
+    func->setAttributes(AttrSet(func->getAttributes())
+                            .add(llvm::AttributeSet::FunctionIndex,
+                                 DtoFunctionAttributes(
+                                     f, getIrFunc(fdecl)->irFty, fdecl)));
     if (global.params.disableRedZone) {
       func->addFnAttr(LLAttribute::NoRedZone);
     }
@@ -15,6 +15,7 @@
 #define LDC_GEN_FUNCTIONS_H
 
 #include "mars.h"
+#include "gen/attributes.h"
 
 class DValue;
 class Expression;
@@ -23,6 +24,7 @@ struct IRAsmBlock;
 struct IrFuncTy;
 class Parameter;
 class Type;
+class TypeFunction;
 namespace llvm {
 class FunctionType;
 }
@@ -33,6 +35,12 @@ llvm::FunctionType *DtoFunctionType(Type *t, IrFuncTy &irFty, Type *thistype,
                                     bool isIntrinsic = false);
 llvm::FunctionType *DtoFunctionType(FuncDeclaration *fdecl);
 
+/// Returns the function attributes implied by the D attributes of a function
+/// (nounwind, readonly), for its declaration or calls to it. fdecl is null
+/// for indirect calls.
+AttrBuilder DtoFunctionAttributes(TypeFunction *f, IrFuncTy &irFty,
+                                  FuncDeclaration *fdecl);
+
 void DtoResolveFunction(FuncDeclaration *fdecl);
 void DtoDeclareFunction(FuncDeclaration *fdecl);
 void DtoDefineFunction(FuncDeclaration *fd);
@@ -23,6 +23,7 @@
 #include "gen/nested.h"
 #include "gen/pragma.h"
 #include "gen/runtime.h"
+#include "gen/tbaa.h"
 #include "gen/tollvm.h"
 #include "gen/typeinf.h"
 #include "gen/uda.h"
@@ -363,7 +364,10 @@ void DtoAssign(Loc &loc, DValue *lhs, DValue *rhs, int op,
       assert(r->getType() == lit);
 #endif
     }
-    gIR->ir->CreateStore(r, l);
+    llvm::StoreInst *store = gIR->ir->CreateStore(r, l);
+    if (!lhs->isVar() || !lhs->isVar()->mayAlias) {
+      DtoSetTBAA(store, lhs->getType());
+    }
   }
 }
 
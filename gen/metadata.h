@@ -48,4 +48,20 @@ enum ClassDataFields {
   CD_NumFields /// The number of fields in ClassInfo metadata
 };
 
+// *** Metadata for the vtables of D classes, emitted for -d-devirtualize ***
+#define VD_PREFIX "llvm.ldc.vtbl."
+
+/// The fields in the metadata node for the vtable of a D class.
+/// (Its name will be VD_PREFIX ~ <Name of vtable global>)
+enum VtblDataFields {
+  VD_BaseVtbl, /// The name of the vtable of the base class, if it's a D class.
+
+  // Must be kept last
+  VD_NumFields /// The number of fields in vtable metadata
+};
+
+/// Attached to the loads of function pointers from D vtables: the name of the
+/// vtable of the static class of the object, and the index of the slot.
+#define VCALL_METADATA "ldc.vcall"
+
 #endif
@@ -12,6 +12,7 @@
 #include "gen/cl_helpers.h"
 #include "gen/logger.h"
 #include "gen/passes/Passes.h"
+#include "gen/timetrace.h"
 #include "llvm/LinkAllPasses.h"
 #if LDC_LLVM_VER >= 307
 #include "llvm/IR/LegacyPassManager.h"
@@ -105,6 +106,23 @@ cl::opt<opts::SanitizerCheck> opts::sanitize(
                clEnumValN(opts::ThreadSanitizer, "thread", "race detection"),
                clEnumValEnd));
 
+cl::opt<opts::DevirtualizationMode> opts::devirtualize(
+    "d-devirtualize",
+    cl::desc("Turn virtual calls on D classes into direct calls when "
+             "optimizing, assuming that every subclass of the classes "
+             "defined in the module is defined in it too. Requires "
+             "-singleobj, over the whole program:"),
+    cl::init(opts::NoDevirtualization),
+    cl::values(
+        clEnumValN(opts::NoDevirtualization, "none",
+                   "Keep virtual calls (default)"),
+        clEnumValN(opts::UniqueDevirtualization, "unique",
+                   "Only calls to methods without overriders"),
+        clEnumValN(opts::SpeculativeDevirtualization, "speculative",
+                   "Also call the method of the static class directly when "
+                   "the object turns out to use it"),
+        clEnumValEnd));
+
 static cl::opt<bool> disableLoopUnrolling(
     "disable-loop-unrolling",
     cl::desc("Disable loop unrolling in all relevant passes"), cl::init(false));
@@ -118,12 +136,12 @@ static cl::opt<bool>
                             cl::desc("Disable the slp vectorization pass"),
                             cl::init(false));
 
-static unsigned optLevel() {
+unsigned optLevel() {
   // Use -O2 as a base for the size-optimization levels.
   return optimizeLevel >= 0 ? optimizeLevel : 2;
 }
 
-static unsigned sizeLevel() { return optimizeLevel < 0 ? -optimizeLevel : 0; }
+unsigned sizeLevel() { return optimizeLevel < 0 ? -optimizeLevel : 0; }
 
 // Determines whether or not to run the normal, full inlining pass.
 bool willInline() {
@@ -174,6 +192,14 @@ static void addGarbageCollect2StackPass(const PassManagerBuilder &builder,
   }
 }
 
+static void addDevirtualizeDClassesPass(const PassManagerBuilder &builder,
+                                        PassManagerBase &pm) {
+  if (builder.OptLevel >= 1) {
+    addPass(pm, createDevirtualizeDClassesPass(
+                    opts::devirtualize == opts::SpeculativeDevirtualization));
+  }
+}
+
 static void addAddressSanitizerPasses(const PassManagerBuilder &Builder,
                                       PassManagerBase &PM) {
   PM.add(createAddressSanitizerFunctionPass());
@@ -287,6 +313,12 @@ static void addOptimizationPasses(PassManagerBase &mpm,
       builder.addExtension(PassManagerBuilder::EP_LoopOptimizerEnd,
                            addGarbageCollect2StackPass);
     }
+
+    // Early, so that the direct calls get inlined
+    if (opts::devirtualize != opts::NoDevirtualization) {
+      builder.addExtension(PassManagerBuilder::EP_ModuleOptimizerEarly,
+                           addDevirtualizeDClassesPass);
+    }
   }
 
   // EP_OptimizerLast does not exist in LLVM 3.0, add it manually below.
@@ -301,6 +333,8 @@ static void addOptimizationPasses(PassManagerBase &mpm,
 // This function runs optimization passes based on command line arguments.
 // Returns true if any optimization passes were invoked.
 bool ldc_optimize_module(llvm::Module *M) {
+  TimeTraceScope timeScope("Optimize", M->getModuleIdentifier());
+
 // Create a PassManager to hold and optimize the collection of
 // per-module passes we are about to build.
 #if LDC_LLVM_VER >= 307
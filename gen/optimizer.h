@@ -30,6 +30,14 @@ enum SanitizerCheck {
 };
 
 extern llvm::cl::opt<SanitizerCheck> sanitize;
+
+enum DevirtualizationMode {
+  NoDevirtualization,
+  UniqueDevirtualization,
+  SpeculativeDevirtualization
+};
+
+extern llvm::cl::opt<DevirtualizationMode> devirtualize;
 }
 
 namespace llvm {
@@ -38,6 +46,12 @@ class Module;
 
 bool ldc_optimize_module(llvm::Module *m);
 
+// The -O level, -Os and -Oz counting as 2.
+unsigned optLevel();
+
+// 1 for -Os, 2 for -Oz, 0 otherwise.
+unsigned sizeLevel();
+
 // Returns whether the normal, full inlining pass will be run.
 bool willInline();
 
@@ -0,0 +1,239 @@
+//===-- DevirtualizeDClasses.cpp - Devirtualize calls on D classes --------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This transform turns virtual calls on D classes into direct calls, using the
+// vtable metadata emitted for -d-devirtualize to find every subclass of the
+// static class of the object.
+// When no subclass overrides the called slot, the load of the function pointer
+// is replaced with the function. Otherwise, in speculative mode, the calls
+// compare the loaded pointer with the function of the static class and call it
+// directly if they are equal, so that it can get inlined.
+//
+// The pass assumes that every subclass of the classes defined in the module is
+// defined in it too, which only holds when compiling the whole program at once.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "devirtualize-d-classes"
+
+#include "gen/metadata.h"
+
+#include "Passes.h"
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+STATISTIC(NumDevirtualized, "Number of virtual calls made direct");
+STATISTIC(NumSpeculated, "Number of virtual calls given a direct fast path");
+
+namespace {
+/// The functions that a slot of a vtable may contain at runtime.
+struct SlotTargets {
+  bool Known = false;      // Whether every subclass could be inspected
+  Function *Own = nullptr; // The function in the vtable of the static class
+  SmallSetVector<Function *, 4> Targets;
+};
+
+struct LLVM_LIBRARY_VISIBILITY DevirtualizeDClasses : public ModulePass {
+  static char ID; // Pass identification, replacement for typeid
+  bool Speculative;
+
+  explicit DevirtualizeDClasses(bool speculative = false)
+      : ModulePass(ID), Speculative(speculative) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  /// The vtables of the direct subclasses of each class, by vtable name.
+  StringMap<SmallVector<StringRef, 2>> Subclasses;
+
+  SlotTargets findTargets(Module &M, StringRef Vtbl, unsigned Index);
+  bool speculate(LoadInst *Load, Function *Target);
+};
+}
+
+char DevirtualizeDClasses::ID = 0;
+static RegisterPass<DevirtualizeDClasses>
+    X("devirtualize-d-classes",
+      "Turn virtual calls on D classes into direct calls");
+
+ModulePass *createDevirtualizeDClassesPass(bool speculative) {
+  return new DevirtualizeDClasses(speculative);
+}
+
+SlotTargets DevirtualizeDClasses::findTargets(Module &M, StringRef Vtbl,
+                                              unsigned Index) {
+  SlotTargets Result;
+
+  SmallVector<StringRef, 8> Worklist;
+  Worklist.push_back(Vtbl);
+  while (!Worklist.empty()) {
+    StringRef Name = Worklist.pop_back_val();
+
+    GlobalVariable *GV = M.getGlobalVariable(Name, true);
+    if (!GV || !GV->hasDefinitiveInitializer()) {
+      return Result;
+    }
+    Constant *Slot = GV->getInitializer()->getAggregateElement(Index);
+    if (!Slot) {
+      return Result;
+    }
+
+    // Abstract functions have null slots
+    if (!Slot->isNullValue()) {
+      auto F = dyn_cast<Function>(Slot->stripPointerCasts());
+      if (!F) {
+        return Result;
+      }
+      Result.Targets.insert(F);
+      if (Name == Vtbl) {
+        Result.Own = F;
+      }
+    }
+
+    auto I = Subclasses.find(Name);
+    if (I != Subclasses.end()) {
+      Worklist.append(I->second.begin(), I->second.end());
+    }
+  }
+
+  Result.Known = true;
+  return Result;
+}
+
+// Guards each call through Load with a comparison against Target, calling
+// Target directly when it matches.
+bool DevirtualizeDClasses::speculate(LoadInst *Load, Function *Target) {
+  SmallVector<CallInst *, 4> Calls;
+  for (User *U : Load->users()) {
+    if (auto CI = dyn_cast<CallInst>(U)) {
+      if (CI->getCalledValue() == Load) {
+        Calls.push_back(CI);
+      }
+    } else if (auto BC = dyn_cast<BitCastInst>(U)) {
+      for (User *BU : BC->users()) {
+        auto CI = dyn_cast<CallInst>(BU);
+        if (CI && CI->getCalledValue() == BC) {
+          Calls.push_back(CI);
+        }
+      }
+    }
+  }
+
+  for (CallInst *Call : Calls) {
+    IRBuilder<> Builder(Call);
+    Value *Cond = Builder.CreateICmpEQ(
+        Load, ConstantExpr::getBitCast(Target, Load->getType()));
+
+    TerminatorInst *ThenTerm, *ElseTerm;
+    SplitBlockAndInsertIfThenElse(Cond, Call, &ThenTerm, &ElseTerm);
+    BasicBlock *Tail = ThenTerm->getSuccessor(0);
+
+    auto Direct = cast<CallInst>(Call->clone());
+    Direct->setCalledFunction(
+        ConstantExpr::getBitCast(Target, Call->getCalledValue()->getType()));
+    Direct->insertBefore(ThenTerm);
+    Call->moveBefore(ElseTerm);
+
+    if (!Call->getType()->isVoidTy()) {
+      PHINode *Phi = PHINode::Create(Call->getType(), 2, "", &Tail->front());
+      Call->replaceAllUsesWith(Phi);
+      Phi->addIncoming(Direct, ThenTerm->getParent());
+      Phi->addIncoming(Call, ElseTerm->getParent());
+    }
+    ++NumSpeculated;
+  }
+
+  return !Calls.empty();
+}
+
+bool DevirtualizeDClasses::runOnModule(Module &M) {
+  Subclasses.clear();
+
+  StringRef Prefix(VD_PREFIX);
+  for (NamedMDNode &Node : M.named_metadata()) {
+    StringRef Name = Node.getName();
+    if (!Name.startswith(Prefix) || Node.getNumOperands() != 1) {
+      continue;
+    }
+    MDNode *MD = Node.getOperand(0);
+    if (MD->getNumOperands() != VD_NumFields) {
+      continue;
+    }
+    auto Base = dyn_cast<MDString>(MD->getOperand(VD_BaseVtbl));
+    if (Base && !Base->getString().empty()) {
+      Subclasses[Base->getString()].push_back(Name.substr(Prefix.size()));
+    }
+  }
+
+  unsigned KindID = M.getContext().getMDKindID(VCALL_METADATA);
+  SmallVector<LoadInst *, 16> Loads;
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        auto Load = dyn_cast<LoadInst>(&I);
+        if (Load && Load->getMetadata(KindID)) {
+          Loads.push_back(Load);
+        }
+      }
+    }
+  }
+
+  bool Changed = false;
+  DenseMap<MDNode *, SlotTargets> Cache;
+  for (LoadInst *Load : Loads) {
+    MDNode *MD = Load->getMetadata(KindID);
+    auto I = Cache.find(MD);
+    if (I == Cache.end()) {
+      SlotTargets Targets;
+      auto Vtbl = MD->getNumOperands() == 2
+                      ? dyn_cast<MDString>(MD->getOperand(0))
+                      : nullptr;
+      auto Index =
+          Vtbl ? mdconst::dyn_extract<ConstantInt>(MD->getOperand(1)) : nullptr;
+      if (Vtbl && Index) {
+        Targets = findTargets(M, Vtbl->getString(), Index->getZExtValue());
+      }
+      I = Cache.insert(std::make_pair(MD, std::move(Targets))).first;
+    }
+    SlotTargets &Targets = I->second;
+    if (!Targets.Known) {
+      continue;
+    }
+
+    if (Targets.Targets.size() == 1) {
+      DEBUG(errs() << "Devirtualizing: " << *Load << " to "
+                   << Targets.Targets[0]->getName() << '\n');
+      Load->replaceAllUsesWith(
+          ConstantExpr::getBitCast(Targets.Targets[0], Load->getType()));
+      Load->eraseFromParent();
+      ++NumDevirtualized;
+      Changed = true;
+    } else if (Speculative && Targets.Own && Targets.Targets.size() > 1) {
+      DEBUG(errs() << "Speculating: " << *Load << " to "
+                   << Targets.Own->getName() << '\n');
+      Changed |= speculate(Load, Targets.Own);
+    }
+  }
+
+  return Changed;
+}
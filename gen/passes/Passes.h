@@ -27,4 +27,6 @@ llvm::FunctionPass *createGarbageCollect2Stack();
 
 llvm::ModulePass *createStripExternalsPass();
 
+llvm::ModulePass *createDevirtualizeDClassesPass(bool speculative);
+
 #endif
@@ -0,0 +1,118 @@
+//===-- tbaa.cpp ----------------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The type tree follows Clang's: every scalar type node is a child of an
+// omnipotent node, which the byte-sized types use since D code commonly
+// accesses any memory through ubyte[] or void[]. Signedness and qualifiers
+// don't matter, and all the pointers share a node. Aggregates, arrays,
+// delegates, vectors and complex numbers get no tag.
+//
+// Unions and other overlapping fields are never tagged. D has no strict
+// aliasing rule: @system code may cast pointers to unrelated types, and even
+// @safe code may take the addresses of different union members. So the tags
+// are only emitted on request.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gen/tbaa.h"
+#include "declaration.h"
+#include "mtype.h"
+#include "gen/irstate.h"
+#include "gen/optimizer.h"
+#include "ir/irfunction.h"
+#include "llvm/IR/MDBuilder.h"
+
+llvm::cl::opt<opts::TBAAMode> opts::tbaa(
+    "d-tbaa",
+    llvm::cl::desc("Type-based alias analysis metadata for D loads and stores, "
+                   "emitted when optimizing:"),
+    llvm::cl::init(opts::NoTBAA),
+    llvm::cl::values(
+        clEnumValN(opts::NoTBAA, "none", "No TBAA metadata (default)"),
+        clEnumValN(opts::StrictTBAA, "strict",
+                   "In every function, assuming the code never accesses "
+                   "memory through pointers to unrelated types"),
+        clEnumValEnd));
+
+namespace {
+
+const char *scalarTypeName(Type *t) {
+  switch (t->ty) {
+  case Tint8:
+  case Tuns8:
+  case Tchar:
+  case Tbool:
+    return nullptr; // omnipotent
+  case Tint16:
+  case Tuns16:
+  case Twchar:
+    return "short";
+  case Tint32:
+  case Tuns32:
+  case Tdchar:
+    return "int";
+  case Tint64:
+  case Tuns64:
+    return "long";
+  case Tint128:
+  case Tuns128:
+    return "cent";
+  // The imaginary types have the same representation as the real ones
+  case Tfloat32:
+  case Timaginary32:
+    return "float";
+  case Tfloat64:
+  case Timaginary64:
+    return "double";
+  case Tfloat80:
+  case Timaginary80:
+    return "real";
+  case Tclass:
+    return isClassValue(t) ? "" : "pointer"; // CALYPSO C++ class values
+  case Tpointer:
+  case Taarray:
+  case Tnull:
+    return "pointer";
+  default:
+    return "";
+  }
+}
+
+bool isTBAAEnabled() {
+  return opts::tbaa == opts::StrictTBAA && isOptimizationEnabled() &&
+         !gIR->functions.empty();
+}
+
+} // anonymous namespace
+
+llvm::MDNode *DtoTBAATag(Type *t) {
+  if (!isTBAAEnabled()) {
+    return nullptr;
+  }
+
+  const char *name = scalarTypeName(t->toBasetype());
+  if (name && !*name) {
+    return nullptr;
+  }
+
+  // The nodes are uniqued by the LLVMContext
+  llvm::MDBuilder builder(gIR->context());
+  llvm::MDNode *node = builder.createTBAAScalarTypeNode(
+      "omnipotent ubyte", builder.createTBAARoot("D TBAA"));
+  if (name) {
+    node = builder.createTBAAScalarTypeNode(name, node);
+  }
+  return builder.createTBAAStructTagNode(node, node, 0);
+}
+
+void DtoSetTBAA(llvm::Instruction *inst, Type *t) {
+  if (llvm::MDNode *tag = DtoTBAATag(t)) {
+    inst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+}
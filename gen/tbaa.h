@@ -0,0 +1,43 @@
+//===-- gen/tbaa.h - Type-based alias analysis metadata ---------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Tags the loads and stores of D scalars with TBAA metadata when optimizing,
+// so that e.g. a store through an int* isn't assumed to clobber a double.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_GEN_TBAA_H
+#define LDC_GEN_TBAA_H
+
+#include "llvm/Support/CommandLine.h"
+
+namespace opts {
+
+enum TBAAMode {
+  NoTBAA,    // No TBAA metadata
+  StrictTBAA // In every function
+};
+
+extern llvm::cl::opt<TBAAMode> tbaa;
+}
+
+namespace llvm {
+class Instruction;
+class MDNode;
+}
+class Type;
+
+/// Returns the TBAA access tag for a load or store of a value of type t in the
+/// current function, or null if the access must be assumed to alias anything.
+llvm::MDNode *DtoTBAATag(Type *t);
+
+/// Attaches the TBAA access tag of type t, if any, to a load or store.
+void DtoSetTBAA(llvm::Instruction *inst, Type *t);
+
+#endif
@@ -0,0 +1,181 @@
+//===-- timetrace.cpp -----------------------------------------------------===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gen/timetrace.h"
+#include "errors.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Span {
+  const char *name;
+  std::string detail;
+  Clock::time_point start;
+  Clock::duration duration;
+};
+
+struct TimeTrace {
+  Clock::time_point beginning = Clock::now();
+  Clock::duration granularity;
+  std::vector<Span> spans; // finished spans
+  std::vector<Span> stack; // open spans, innermost last
+
+  explicit TimeTrace(unsigned granularityMicroseconds)
+      : granularity(std::chrono::microseconds(granularityMicroseconds)) {}
+
+  long long microseconds(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  }
+
+  void writeEvent(llvm::raw_ostream &os, bool &first, llvm::StringRef name,
+                  llvm::StringRef detail, long long ts, long long dur,
+                  unsigned tid) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os << "{\"pid\":1,\"tid\":" << tid << ",\"ph\":\"X\",\"ts\":" << ts
+       << ",\"dur\":" << dur << ",\"name\":\"";
+    writeEscaped(os, name);
+    os << "\"";
+    if (!detail.empty()) {
+      os << ",\"args\":{\"detail\":\"";
+      writeEscaped(os, detail);
+      os << "\"}";
+    }
+    os << "}";
+  }
+
+  static void writeEscaped(llvm::raw_ostream &os, llvm::StringRef str) {
+    for (unsigned char c : str) {
+      if (c == '"' || c == '\\') {
+        os << '\\' << c;
+      } else if (c < 0x20) {
+        os << "\\u00";
+        os.write_hex(c >> 4);
+        os.write_hex(c & 0xF);
+      } else {
+        os << c;
+      }
+    }
+  }
+
+  void write(llvm::raw_ostream &os) {
+    os << "{\"traceEvents\":[";
+    bool first = true;
+
+    for (auto &span : spans) {
+      writeEvent(os, first, span.name, span.detail,
+                 microseconds(span.start - beginning),
+                 microseconds(span.duration), 0);
+    }
+
+    // Total time per kind of span, counting recursive spans only once
+    struct Total {
+      Clock::duration duration;
+      size_t count;
+    };
+    llvm::StringMap<Total> totals;
+    std::vector<const Span *> open;
+    std::vector<const Span *> sorted;
+    for (auto &span : spans)
+      sorted.push_back(&span);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Span *a, const Span *b) {
+                       return a->start < b->start ||
+                              (a->start == b->start &&
+                               a->duration > b->duration);
+                     });
+    for (auto span : sorted) {
+      while (!open.empty() &&
+             open.back()->start + open.back()->duration <= span->start)
+        open.pop_back();
+      bool nested = false;
+      for (auto o : open)
+        nested |= (llvm::StringRef(o->name) == span->name);
+      auto &total = totals[span->name];
+      if (!nested)
+        total.duration += span->duration;
+      total.count++;
+      open.push_back(span);
+    }
+
+    std::vector<std::pair<llvm::StringRef, Total>> byDuration;
+    for (auto &entry : totals)
+      byDuration.emplace_back(entry.getKey(), entry.getValue());
+    std::sort(byDuration.begin(), byDuration.end(),
+              [](const std::pair<llvm::StringRef, Total> &a,
+                 const std::pair<llvm::StringRef, Total> &b) {
+                return a.second.duration > b.second.duration;
+              });
+    unsigned tid = 1;
+    for (auto &entry : byDuration) {
+      std::string name = ("Total " + entry.first).str();
+      std::string detail = std::to_string(entry.second.count) + " spans";
+      writeEvent(os, first, name, detail, 0,
+                 microseconds(entry.second.duration), tid++);
+    }
+
+    os << "\n],\n\"displayTimeUnit\":\"ms\"}\n";
+  }
+};
+
+std::unique_ptr<TimeTrace> timeTrace;
+
+} // anonymous namespace
+
+void initializeTimeTrace(unsigned granularityMicroseconds) {
+  assert(!timeTrace);
+  timeTrace.reset(new TimeTrace(granularityMicroseconds));
+}
+
+bool timeTraceEnabled() { return timeTrace != nullptr; }
+
+void timeTraceBegin(const char *name, llvm::StringRef detail) {
+  assert(timeTrace);
+  timeTrace->stack.push_back(
+      {name, detail.str(), Clock::now(), Clock::duration::zero()});
+}
+
+void timeTraceEnd() {
+  assert(timeTrace && !timeTrace->stack.empty());
+  Span span = std::move(timeTrace->stack.back());
+  timeTrace->stack.pop_back();
+  span.duration = Clock::now() - span.start;
+
+  // Keep the outermost spans no matter how short so that each phase shows up
+  if (span.duration >= timeTrace->granularity || timeTrace->stack.empty())
+    timeTrace->spans.push_back(std::move(span));
+}
+
+void writeTimeTrace(const std::string &filename) {
+  if (!timeTrace)
+    return;
+
+  // Close the spans left open by fatal errors
+  while (!timeTrace->stack.empty())
+    timeTraceEnd();
+
+  std::error_code errinfo;
+  llvm::raw_fd_ostream os(filename, errinfo, llvm::sys::fs::F_Text);
+  if (errinfo) {
+    error(Loc(), "cannot write time trace '%s': %s", filename.c_str(),
+          errinfo.message().c_str());
+  } else {
+    timeTrace->write(os);
+  }
+  timeTrace.reset();
+}
@@ -0,0 +1,65 @@
+//===-- gen/timetrace.h - Compilation time profiling ------------*- C++ -*-===//
+//
+//                         LDC – the LLVM D compiler
+//
+// This file is distributed under the BSD-style LDC license. See the LICENSE
+// file for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Records nested time spans of the compilation (-ftime-trace) and writes them
+// as a JSON file in the Chrome trace event format, which can be viewed with
+// chrome://tracing.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LDC_GEN_TIMETRACE_H
+#define LDC_GEN_TIMETRACE_H
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <utility>
+
+/// Starts recording. Spans shorter than granularityMicroseconds are dropped.
+void initializeTimeTrace(unsigned granularityMicroseconds);
+
+/// Returns whether the time spans are being recorded.
+bool timeTraceEnabled();
+
+void timeTraceBegin(const char *name, llvm::StringRef detail);
+void timeTraceEnd();
+
+/// Writes the recorded spans along with the total time of each kind of span
+/// to filename, and stops recording.
+void writeTimeTrace(const std::string &filename);
+
+/// Records a span for the lifetime of the object. The detail, e.g. the name
+/// of the instantiated template, is only computed if recording.
+class TimeTraceScope {
+  bool active;
+
+public:
+  explicit TimeTraceScope(const char *name, llvm::StringRef detail = "")
+      : active(timeTraceEnabled()) {
+    if (active)
+      timeTraceBegin(name, detail);
+  }
+
+  template <typename DetailFn,
+            typename = decltype(std::declval<DetailFn>()())>
+  TimeTraceScope(const char *name, DetailFn detail)
+      : active(timeTraceEnabled()) {
+    if (active)
+      timeTraceBegin(name, detail());
+  }
+
+  ~TimeTraceScope() {
+    if (active)
+      timeTraceEnd();
+  }
+
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  TimeTraceScope &operator=(const TimeTraceScope &) = delete;
+};
+
+#endif
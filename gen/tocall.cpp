@@ -792,6 +792,11 @@ DValue *DtoCallFunction(Loc &loc, Type *resulttype, DValue *fnval,
   // return attrs
   attrs.add(0, irFty.ret->attrs);
 
+  // function attrs, also for virtual and indirect calls
+  const AttrBuilder fnAttrs =
+      DtoFunctionAttributes(tf, irFty, dfnval ? dfnval->func : nullptr);
+  attrs.add(llvm::AttributeSet::FunctionIndex, fnAttrs);
+
   std::vector<LLValue *> args;
   args.reserve(irFty.args.size());
 
@@ -847,7 +852,8 @@ DValue *DtoCallFunction(Loc &loc, Type *resulttype, DValue *fnval,
                        numFormalParams);
 
   // call the function
-  LLCallSite call = gIR->func()->scopes->callOrInvoke(callable, args);
+  LLCallSite call = gIR->func()->scopes->callOrInvoke(
+      callable, args, "", fnAttrs.contains(LLAttribute::NoUnwind));
 
   // get return value
   const int sretArgIndex =
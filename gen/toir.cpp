@@ -1181,7 +1181,10 @@ public:
       assert(!isSpecialRefVar(e->var->isVarDeclaration()) &&
              "Code not expected to handle special ref vars, although it can "
              "easily be made to.");
-      result = new DVarValue(e->type, V);
+      VarDeclaration *vd = e->var->isVarDeclaration();
+      auto field = new DVarValue(e->type, V);
+      field->mayAlias = vd && vd->overlapped;
+      result = field;
       return;
     }
 
@@ -1214,7 +1217,9 @@ public:
       }
 
       // Logger::cout() << "mem: " << *arrptr << '\n';
-      result = new DVarValue(e->type, arrptr);
+      auto field = new DVarValue(e->type, arrptr);
+      field->mayAlias = vd->overlapped;
+      result = field;
     } else if (FuncDeclaration *fdecl = e->var->isFuncDeclaration()) {
       DtoResolveFunction(fdecl);
 
@@ -259,10 +259,11 @@ public:
   void addLabelTarget(Identifier *labelName, llvm::BasicBlock *targetBlock);
 
   /// Emits a call or invoke to the given callee, depending on whether there
-  /// are catches/cleanups active or not.
+  /// are catches/cleanups active or not. isNothrow is for indirect calls
+  /// known not to unwind.
   template <typename T>
   llvm::CallSite callOrInvoke(llvm::Value *callee, const T &args,
-                              const char *name = "");
+                              const char *name = "", bool isNothrow = false);
 
   /// Terminates the current basic block with an unconditional branch to the
   /// given label, along with the cleanups to execute on the way there.
@@ -355,14 +356,15 @@ private:
 
 template <typename T>
 llvm::CallSite ScopeStack::callOrInvoke(llvm::Value *callee, const T &args,
-                                        const char *name) {
+                                        const char *name, bool isNothrow) {
   // If this is a direct call, we might be able to use the callee attributes
   // to our advantage.
   llvm::Function *calleeFn = llvm::dyn_cast<llvm::Function>(callee);
 
   // Intrinsics don't support invoking and 'nounwind' functions don't need it.
   const bool doesNotThrow =
-      calleeFn && (calleeFn->isIntrinsic() || calleeFn->doesNotThrow());
+      isNothrow ||
+      (calleeFn && (calleeFn->isIntrinsic() || calleeFn->doesNotThrow()));
 
   if (doesNotThrow || (cleanupScopes.empty() && catchScopes.empty())) {
     llvm::CallInst *call = irs->ir->CreateCall(callee, args, name);
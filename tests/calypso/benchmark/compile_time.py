@@ -0,0 +1,246 @@
+#!/usr/bin/env python
+# Measures how long ldc2 takes to import and instantiate C++ declarations, and
+# how much memory it uses, over a set of generated scenarios.
+#
+# Every scenario is compiled --repeat times in its own directory (so that each
+# one has its own calypso_cache), and the wall time, the time spent in each
+# compilation phase (from -ftime-trace) and the peak resident set size (from
+# -memory-report-file) are written as JSON to --output.
+#
+# With --baseline, the median wall times are compared against an earlier
+# output and the script fails if any scenario got slower than --tolerance.
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+SCALARS = ['byte', 'ubyte', 'short', 'ushort', 'int', 'uint', 'long', 'ulong',
+           'float', 'double', 'char', 'bool']
+
+
+def header(modmaps, imports):
+    lines = ['modmap (C++) "<%s>";' % m for m in modmaps]
+    lines += ['import (C++) %s;' % i for i in imports]
+    return '\n'.join(lines) + '\n\n'
+
+
+def single_import_module():
+    return header(['vector'], ['std.vector']) + '''\
+size_t fill(int n)
+{
+    auto v = new vector!int;
+    foreach (i; 0 .. n)
+        v.push_back(i);
+    return v.size();
+}
+'''
+
+
+def imports_module(index):
+    return header(['vector', 'map', 'string', 'regex'],
+                  ['std.vector', 'std.map', 'std.regex',
+                   'std._ : cppstring = string']) + '''\
+size_t use%d(int n)
+{
+    auto v = new vector!int;
+    v.push_back(n);
+    map!(int, cppstring) m;
+    m[n] = cppstring("calypso");
+    return v.size() + m.size();
+}
+''' % index
+
+
+def instantiation_module(count):
+    body = header(['vector', 'map'], ['std.vector', 'std.map'])
+    types = SCALARS[:max(1, min(count, len(SCALARS)))]
+    for i, t in enumerate(types):
+        body += '''\
+size_t vector_%(i)d(%(t)s x)
+{
+    auto v = new vector!(%(t)s);
+    v.reserve(4);
+    v.push_back(x);
+    v.resize(8);
+    return v.size() + v.capacity();
+}
+
+''' % {'i': i, 't': t}
+    for i, k in enumerate(types):
+        v = types[(i + 1) % len(types)]
+        body += '''\
+size_t map_%(i)d(%(k)s k, %(v)s x)
+{
+    map!(%(k)s, %(v)s) m;
+    m[k] = x;
+    return m.size();
+}
+
+''' % {'i': i, 'k': k, 'v': v}
+    return body
+
+
+def scenarios(args):
+    """(name, {filename: source}, keep the cache between runs)"""
+    single = {'single.d': single_import_module()}
+    imports = dict(('import%d.d' % i, imports_module(i))
+                   for i in range(args.modules))
+    inst = {'instantiation.d': instantiation_module(args.instantiations)}
+    return [
+        ('cold-pch', single, False),
+        ('warm-pch', single, True),
+        ('imports-%d' % args.modules, imports, True),
+        ('instantiation-%d' % args.instantiations, inst, True),
+    ]
+
+
+def remove_cache(workdir):
+    for f in os.listdir(workdir):
+        if f.startswith('calypso_cache'):
+            path = os.path.join(workdir, f)
+            if os.path.isdir(path):
+                shutil.rmtree(path)
+            else:
+                os.remove(path)
+
+
+def compile_once(args, workdir, sources):
+    trace = os.path.join(workdir, 'time-trace.json')
+    memory = os.path.join(workdir, 'memory.json')
+    cmd = [args.ldc2, '-c', '-od=' + os.path.join(workdir, 'obj'),
+           '-ftime-trace', '-ftime-trace-file=' + trace,
+           '-memory-report-file=' + memory]
+    cmd += ['-cpp-args=' + a for a in args.cpp_args]
+    cmd += args.ldc_args + sorted(sources)
+
+    start = time.time()
+    proc = subprocess.Popen(cmd, cwd=workdir, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    output = proc.communicate()[0]
+    wall = time.time() - start
+    if proc.returncode != 0:
+        sys.exit('%s failed:\n%s' % (' '.join(cmd), output.decode('utf-8',
+                                                                   'replace')))
+
+    phases = {}
+    with open(trace) as f:
+        for event in json.load(f)['traceEvents']:
+            name = event['name']
+            if name.startswith('Total '):
+                phases[name[len('Total '):]] = event['dur'] / 1e6
+    with open(memory) as f:
+        report = json.load(f)
+
+    return {'wallSeconds': wall, 'phasesSeconds': phases,
+            'peakResidentBytes': report['peakResidentBytes'],
+            'clangAstBytes': report['clang']['astBytes']}
+
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    return values[n // 2] if n % 2 else (values[n // 2 - 1] + values[n // 2]) / 2
+
+
+def run_scenario(args, name, sources, warm):
+    workdir = os.path.join(args.work_dir, name)
+    if os.path.isdir(workdir):
+        shutil.rmtree(workdir)
+    os.makedirs(workdir)
+    for filename, source in sources.items():
+        with open(os.path.join(workdir, filename), 'w') as f:
+            f.write(source)
+
+    if warm:
+        compile_once(args, workdir, sources)  # builds the PCH
+
+    runs = []
+    for _ in range(args.repeat):
+        if not warm:
+            remove_cache(workdir)
+        runs.append(compile_once(args, workdir, sources))
+
+    fastest = min(runs, key=lambda r: r['wallSeconds'])
+    return {
+        'name': name,
+        'modules': len(sources),
+        'wallSeconds': [r['wallSeconds'] for r in runs],
+        'medianWallSeconds': median([r['wallSeconds'] for r in runs]),
+        'phasesSeconds': fastest['phasesSeconds'],
+        'peakResidentBytes': max(r['peakResidentBytes'] for r in runs),
+        'clangAstBytes': fastest['clangAstBytes'],
+    }
+
+
+def compare(results, baseline_file, tolerance):
+    with open(baseline_file) as f:
+        baseline = dict((s['name'], s) for s in json.load(f)['scenarios'])
+
+    regressed = False
+    for s in results:
+        base = baseline.get(s['name'])
+        if not base:
+            continue
+        ratio = s['medianWallSeconds'] / base['medianWallSeconds']
+        status = 'ok'
+        if ratio > 1 + tolerance / 100.0:
+            status = 'REGRESSION'
+            regressed = True
+        print('%-20s %7.3fs -> %7.3fs (%+.1f%%) %s' %
+              (s['name'], base['medianWallSeconds'], s['medianWallSeconds'],
+               (ratio - 1) * 100, status))
+    return not regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Benchmark the compilation of Calypso C++ imports.')
+    parser.add_argument('--ldc2', required=True, help='ldc2 executable')
+    parser.add_argument('--work-dir', default='calypso_benchmark',
+                        help='where the scenarios get generated and compiled')
+    parser.add_argument('--output', default='compile_time.json',
+                        help='JSON file to write the results to')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='compilations per scenario')
+    parser.add_argument('--modules', type=int, default=8,
+                        help='modules importing std.vector/map/regex')
+    parser.add_argument('--instantiations', type=int, default=len(SCALARS),
+                        help='element types of the template instances')
+    parser.add_argument('--cpp-args', action='append', default=['-std=c++11'],
+                        help='Clang argument for the PCH generation')
+    parser.add_argument('--ldc-args', nargs=argparse.REMAINDER, default=[],
+                        help='remaining arguments are passed to ldc2')
+    parser.add_argument('--baseline', help='earlier output to compare with')
+    parser.add_argument('--tolerance', type=float, default=10,
+                        help='allowed slowdown against the baseline in %%')
+    args = parser.parse_args()
+
+    args.ldc2 = os.path.abspath(args.ldc2)
+    args.work_dir = os.path.abspath(args.work_dir)
+
+    results = []
+    for name, sources, warm in scenarios(args):
+        s = run_scenario(args, name, sources, warm)
+        print('%-20s %7.3fs  peak %6d MB  %s' %
+              (s['name'], s['medianWallSeconds'],
+               s['peakResidentBytes'] // (1024 * 1024),
+               ', '.join('%s %.3fs' % p
+                         for p in sorted(s['phasesSeconds'].items()))))
+        results.append(s)
+
+    with open(args.output, 'w') as f:
+        json.dump({'ldc2': args.ldc2, 'repeat': args.repeat,
+                   'scenarios': results}, f, indent=2, sort_keys=True)
+
+    if args.baseline and not compare(results, args.baseline, args.tolerance):
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
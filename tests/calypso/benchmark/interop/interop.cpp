@@ -0,0 +1,73 @@
+#include "interop.hpp"
+
+#define NOINLINE __attribute__((noinline))
+
+namespace bench {
+    NOINLINE int add(int a, int b) { return a + b; }
+
+    int Shape::area() const { return 0; }
+    int Square::area() const { return side * side; }
+
+    Shape *makeSquare(int side) { return new Square(side); }
+
+    long long sumAreas(const Shape *s, int n)
+    {
+        long long sum = 0;
+        for (int i = 0; i < n; i++)
+            sum += s->area();
+        return sum;
+    }
+
+    int liveTracked = 0;
+
+    NOINLINE Tracked::Tracked(int value) : value(value) { liveTracked++; }
+    NOINLINE Tracked::~Tracked() { liveTracked--; }
+
+    NOINLINE void throwInt(int n) { throw n; }
+
+    void fillVector(std::vector<int> &v, int n)
+    {
+        v.reserve(n);
+        for (int i = 0; i < n; i++)
+            v.push_back(i);
+    }
+
+    long long baselinePlainCalls(int n)
+    {
+        int sum = 0;
+        for (int i = 0; i < n; i++)
+            sum = add(sum, i);
+        return sum;
+    }
+
+    long long baselineConstruction(int n)
+    {
+        long long sum = 0;
+        for (int i = 0; i < n; i++) {
+            Tracked t(i);
+            sum += t.value;
+        }
+        return sum;
+    }
+
+    long long baselineExceptions(int n)
+    {
+        long long sum = 0;
+        for (int i = 0; i < n; i++) {
+            try {
+                throwInt(i);
+            } catch (int e) {
+                sum += e;
+            }
+        }
+        return sum;
+    }
+
+    long long baselineIteration(const std::vector<int> &v)
+    {
+        long long sum = 0;
+        for (int x : v)
+            sum += x;
+        return sum;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+namespace bench {
+    // Plain function, defined out of line and never inlined in the baselines
+    int add(int a, int b);
+
+    // Virtual functions
+    class Shape
+    {
+    public:
+        virtual ~Shape() {}
+        virtual int area() const;
+    };
+
+    class Square : public Shape
+    {
+    public:
+        int side;
+
+        Square(int side) : side(side) {}
+        int area() const override;
+    };
+
+    Shape *makeSquare(int side);
+
+    // Calls s->area() n times through the C++ vtable, which for D classes
+    // overriding area() goes through the thunk generated by Calypso
+    long long sumAreas(const Shape *s, int n);
+
+    // Non-trivial constructor and destructor
+    struct Tracked
+    {
+        int value;
+
+        Tracked(int value);
+        ~Tracked();
+    };
+
+    extern int liveTracked;
+
+    // Exceptions
+    void throwInt(int n);
+
+    // STL containers
+    void fillVector(std::vector<int> &v, int n);
+
+    // Pure C++ baselines running the same loops as the D side
+    long long baselinePlainCalls(int n);
+    long long baselineConstruction(int n);
+    long long baselineExceptions(int n);
+    long long baselineIteration(const std::vector<int> &v);
+}
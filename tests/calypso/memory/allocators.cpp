@@ -0,0 +1,4 @@
+#include "allocators.hpp"
+
+int Counted::allocs = 0;
+int Counted::deallocs = 0;
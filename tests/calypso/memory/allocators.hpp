@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+// Record with class-specific allocation functions, mapped to a D allocator and deallocator
+class Counted {
+public:
+    static int allocs, deallocs;
+    int n;
+
+    Counted(int n) : n(n) {}
+    virtual ~Counted() {}
+
+    static void* operator new(std::size_t sz) { allocs++; return std::malloc(sz); }
+    static void* operator new(std::size_t sz, void* where) { return where; }
+    static void operator delete(void* p) { deallocs++; std::free(p); }
+};
+
+struct alignas(32) Wide {
+    float v[8];
+};
@@ -0,0 +1,7 @@
+namespace partitions
+{
+    template<typename T>
+    T twice(T x) { return x + x; }
+
+    inline int twiceInt(int x) { return twice<int>(x); }
+}
@@ -0,0 +1,28 @@
+namespace partsA
+{
+    unsigned useThrice(unsigned x);
+    long long useThriceLL(long long x);
+}
+
+namespace partsB
+{
+    int useTwice(int x);
+}
+
+namespace partsC
+{
+    template<typename T>
+    T twice(T x) { return x + x; }
+
+    template<typename T>
+    T thrice(T x) { return x + x + x; }
+
+    inline int twiceInt(int x) { return twice<int>(x); }
+}
+
+// Only referenced by partsA, so thrice<unsigned>, owned by the second
+// partition, is a leftover of the last one.
+inline unsigned partsA::useThrice(unsigned x) { return partsC::thrice<unsigned>(x); }
+inline long long partsA::useThriceLL(long long x) { return partsC::thrice<long long>(x); }
+
+inline int partsB::useTwice(int x) { return partsC::twice<int>(x); }
@@ -0,0 +1,5 @@
+namespace pchlayers
+{
+    template<typename T>
+    T twice(T x) { return x + x; }
+}
@@ -0,0 +1,14 @@
+namespace retinplace
+{
+    struct IntPair
+    {
+        int first;
+        int second;
+    };
+
+    inline IntPair makePair(int a, int b)
+    {
+        IntPair p = { a, b };
+        return p;
+    }
+}
@@ -0,0 +1,4 @@
+namespace cppserver
+{
+    inline int answer() { return 42; }
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Compiles cpp_server.d through a compile server started in the background.
+# usage: cpp_server.sh <ldc2> <empty work dir> <source file>
+ldc=$1
+dir=$2
+src=$3
+sock=$dir/server.sock
+
+waitForSocket() {
+    i=0
+    while [ ! -S "$sock" ] && [ $i -lt 300 ]; do
+        sleep 0.1
+        i=$((i + 1))
+    done
+}
+
+cd "$dir" || exit 1
+mkdir other
+
+# Fill the cache, which the server loads at startup
+"$ldc" -c -of=local.o "$src" || exit 1
+
+"$ldc" -cpp-server="$sock" > server.log 2>&1 &
+server=$!
+trap 'kill $server' EXIT
+waitForSocket
+
+echo "--- served"
+CPP_SERVER_TEST=fromclient LDC_CPP_SERVER="$sock" "$ldc" -v -run "$src"
+
+echo "--- other cache directory"
+(cd other && LDC_CPP_SERVER="$sock" "$ldc" -v -c -of=other.o "$src")
+
+echo "--- cache changed"
+echo >> calypso_cache.modulemaps
+LDC_CPP_SERVER="$sock" "$ldc" -v -c -of=changed.o "$src"
+sleep 0.5
+waitForSocket
+
+echo "--- restarted"
+LDC_CPP_SERVER="$sock" "$ldc" -v -c -of=restarted.o "$src"
@@ -0,0 +1,14 @@
+namespace cpptbaa
+{
+    struct Pair
+    {
+        int a;
+        float b;
+    };
+
+    inline int storeThenRead(Pair *p, float *f)
+    {
+        *f = 1.0f;
+        return p->a;
+    }
+}
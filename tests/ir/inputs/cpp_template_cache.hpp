@@ -0,0 +1,8 @@
+namespace tempcache
+{
+    template<typename T>
+    T twice(T x) { return x + x; }
+
+    template<typename T, typename = typename T::type>
+    struct NeedsType {};
+}